@@ -0,0 +1,188 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+// Per-thread hardware performance counters (Linux perf_event_open).
+//
+// Every thread of the process gets one event group: cycles, instructions,
+// last-level cache misses, dTLB load misses and branch misses, counted in
+// user space only. Groups are attached from the calling thread by walking
+// /proc/self/task, so OpenMP teams and thread pools are counted without
+// any change to the code they run. A thread must exist when counters_attach
+// runs to be counted; the labs' warmup runs create their teams first.
+//
+// Containers and VMs often hide the PMU or forbid perf_event_open
+// (perf_event_paranoid, seccomp). counters_init then reports the errno
+// and callers fall back to timing only. Events the PMU lacks are skipped
+// one by one, so a partial set still counts.
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define COUNTERS_MAX_THREADS 256
+
+enum { COUNTER_CYCLES, COUNTER_INSTRUCTIONS, COUNTER_LLC_MISSES, COUNTER_DTLB_MISSES,
+       COUNTER_BRANCH_MISSES, NUM_COUNTERS };
+
+static const char *const counter_names[NUM_COUNTERS] = {
+    "cycles", "instructions", "llc_misses", "dtlb_misses", "branch_misses",
+};
+
+typedef struct {
+    int tid;
+    int leader;               // group leader fd, -1 if nothing opened
+    int fds[NUM_COUNTERS];    // -1 where the event is unavailable
+    int slot[NUM_COUNTERS];   // position in the group read, -1 if absent
+    int nr;                   // events in the group
+} counter_thread_t;
+
+typedef struct {
+    int available;            // the probe opened at least one event
+    int error;                // errno of the probe when it did not
+    int num_threads;
+    counter_thread_t threads[COUNTERS_MAX_THREADS];
+} counter_set_t;
+
+#ifdef __linux__
+
+static inline void counters_event(int counter, struct perf_event_attr *attr) {
+    memset(attr, 0, sizeof(*attr));
+    attr->size = sizeof(*attr);
+    attr->type = PERF_TYPE_HARDWARE;
+    attr->exclude_kernel = 1; // allowed at perf_event_paranoid 2
+    attr->exclude_hv = 1;
+    attr->read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                        PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch (counter) {
+        case COUNTER_CYCLES:       attr->config = PERF_COUNT_HW_CPU_CYCLES; break;
+        case COUNTER_INSTRUCTIONS: attr->config = PERF_COUNT_HW_INSTRUCTIONS; break;
+        case COUNTER_LLC_MISSES:   attr->config = PERF_COUNT_HW_CACHE_MISSES; break;
+        case COUNTER_BRANCH_MISSES: attr->config = PERF_COUNT_HW_BRANCH_MISSES; break;
+        default:
+            attr->type = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                           PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+            break;
+    }
+}
+
+// Open one group on thread tid; returns 0 if at least one event opened,
+// otherwise -1 with errno from the first failure
+static inline int counters_open_thread(counter_thread_t *t, int tid) {
+    int first_error = 0;
+
+    t->tid = tid;
+    t->leader = -1;
+    t->nr = 0;
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+        struct perf_event_attr attr;
+        counters_event(c, &attr);
+        int fd = (int)syscall(SYS_perf_event_open, &attr, tid, -1, t->leader, 0);
+        t->fds[c] = fd;
+        t->slot[c] = -1;
+        if (fd < 0) {
+            if (first_error == 0) first_error = errno;
+            continue;
+        }
+        if (t->leader < 0) t->leader = fd;
+        t->slot[c] = t->nr++;
+    }
+    if (t->leader < 0) {
+        errno = first_error;
+        return -1;
+    }
+    ioctl(t->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return 0;
+}
+
+static inline void counters_close_thread(counter_thread_t *t) {
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+        if (t->fds[c] >= 0) close(t->fds[c]);
+        t->fds[c] = -1;
+    }
+    t->leader = -1;
+}
+
+static inline int counters_init(counter_set_t *cs) {
+    counter_thread_t probe;
+
+    memset(cs, 0, sizeof(*cs));
+    if (counters_open_thread(&probe, 0) != 0) {
+        cs->error = errno;
+        return -1;
+    }
+    counters_close_thread(&probe);
+    cs->available = 1;
+    return 0;
+}
+
+// Attach a group to every thread of the process that does not have one yet
+static inline void counters_attach(counter_set_t *cs) {
+    if (!cs->available) return;
+    DIR *dir = opendir("/proc/self/task");
+    if (dir == NULL) return;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && cs->num_threads < COUNTERS_MAX_THREADS) {
+        int tid = atoi(entry->d_name);
+        int known = tid <= 0;
+        for (int i = 0; i < cs->num_threads && !known; i++) known = cs->threads[i].tid == tid;
+        if (!known && counters_open_thread(&cs->threads[cs->num_threads], tid) == 0) {
+            cs->num_threads++;
+        }
+    }
+    closedir(dir);
+}
+
+// Current counts of every attached thread, scaled up when the kernel had to
+// multiplex the group; absent events read as 0
+static inline void counters_read(const counter_set_t *cs, double (*values)[NUM_COUNTERS]) {
+    uint64_t buf[3 + NUM_COUNTERS];
+
+    for (int i = 0; i < cs->num_threads; i++) {
+        const counter_thread_t *t = &cs->threads[i];
+        memset(values[i], 0, sizeof(values[i]));
+        if (read(t->leader, buf, sizeof(buf)) < (ssize_t)((3 + t->nr) * sizeof(uint64_t))) continue;
+        double scale = buf[2] > 0 && buf[2] < buf[1] ? (double)buf[1] / buf[2] : 1.0;
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+            if (t->slot[c] >= 0) values[i][c] = buf[3 + t->slot[c]] * scale;
+        }
+    }
+}
+
+static inline void counters_close(counter_set_t *cs) {
+    for (int i = 0; i < cs->num_threads; i++) counters_close_thread(&cs->threads[i]);
+    cs->num_threads = 0;
+    cs->available = 0;
+}
+
+#else // !__linux__: timing only
+
+static inline int counters_init(counter_set_t *cs) {
+    memset(cs, 0, sizeof(*cs));
+    cs->error = ENOSYS;
+    return -1;
+}
+
+static inline void counters_attach(counter_set_t *cs) { (void)cs; }
+
+static inline void counters_read(const counter_set_t *cs, double (*values)[NUM_COUNTERS]) {
+    (void)cs;
+    (void)values;
+}
+
+static inline void counters_close(counter_set_t *cs) { cs->available = 0; }
+
+#endif // __linux__
+
+#endif // COUNTERS_H
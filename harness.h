@@ -0,0 +1,418 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+// Benchmark harness shared by the labs.
+//
+// Every timed region runs `warmup` untimed times and then `trials` timed
+// times on the monotonic clock. The samples are reduced to median, mean,
+// p95, standard deviation, min, max and a count of Tukey outliers (outside
+// [Q1 - 1.5 IQR, Q3 + 1.5 IQR]). The labs print medians in their own
+// tables. With --output FILE.csv or FILE.json, each region also becomes one
+// record in a machine-readable file, together with host metadata.
+//
+// With --counters, every timed trial is also bracketed by reads of the
+// per-thread hardware counters in counters.h. The records then carry
+// per-trial cycles, instructions, LLC, dTLB and branch misses, IPC and the
+// DRAM traffic implied by the LLC misses. Without counter access the run
+// carries on, timing only.
+//
+// Typical loop, for code that does per-trial setup around the timed part:
+//
+//   double samples[HARNESS_MAX_TRIALS];
+//   harness_counters_t counters = {0};
+//   for (int trial = -h->warmup; trial < h->trials; trial++) {
+//       ...setup...
+//       double start = harness_start(h, trial);
+//       ...timed work...
+//       harness_stop(h, trial, start, samples, &counters);
+//   }
+//   harness_stats_t stats;
+//   harness_summarize(samples, h->trials, &stats);
+//   record.counters = &counters;
+//   harness_emit(h, &record, &stats);
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#include "counters.h"
+
+#define HARNESS_MAX_TRIALS 1000
+#define HARNESS_DEFAULT_WARMUP 1
+#define HARNESS_DEFAULT_TRIALS 5
+#define HARNESS_CACHE_LINE 64 // bytes moved per LLC miss
+
+typedef enum { HARNESS_NONE, HARNESS_CSV, HARNESS_JSON } harness_format_t;
+
+typedef struct {
+    int warmup;
+    int trials;
+    const char *output;         // NULL: tables only
+    harness_format_t format;    // from the output file's extension
+    const char *program;
+    FILE *fp;
+    int records;
+    int counters;               // --counters given and counters.h could open them
+    counter_set_t counter_set;
+    double counter_start[COUNTERS_MAX_THREADS][NUM_COUNTERS];
+} harness_t;
+
+typedef struct {
+    int trials;
+    double median, mean, stddev, p95, min, max;
+    int outliers;
+} harness_stats_t;
+
+// Counts of one timed region summed over its trials, per attached thread
+// (indices follow counter_set_t.threads)
+typedef struct {
+    int trials;
+    double per_thread[COUNTERS_MAX_THREADS][NUM_COUNTERS];
+} harness_counters_t;
+
+// One timed region. work is what one run does, in the numerator of unit
+// (e.g. 2n^3 * 1e-9 for "GFLOP/s"); the rate is work / median. params
+// holds the lab's own dimensions as "key=value;key=value". counters may
+// stay NULL for regions that are not bracketed.
+typedef struct {
+    const char *benchmark;
+    const char *variant;
+    const char *params;
+    long long size;
+    int threads;
+    double work;
+    const char *unit;
+    const harness_counters_t *counters;
+} harness_record_t;
+
+static inline double harness_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static inline void harness_init(harness_t *h, const char *program) {
+    memset(h, 0, sizeof(*h));
+    h->warmup = HARNESS_DEFAULT_WARMUP;
+    h->trials = HARNESS_DEFAULT_TRIALS;
+    h->program = program;
+}
+
+// Shared options for hand-written argument loops: --warmup N, --trials N,
+// --output FILE.{csv,json}, --counters. Returns 1 if argv[*i] was one of
+// them (and advances *i past its value), 0 if not, -1 if its value is invalid.
+static inline int harness_parse_arg(harness_t *h, int argc, char *argv[], int *i) {
+    const char *arg = argv[*i];
+    if (strcmp(arg, "--counters") == 0) {
+        h->counters = 1;
+        return 1;
+    }
+    if (*i + 1 >= argc) return 0;
+    if (strcmp(arg, "--warmup") == 0) {
+        h->warmup = atoi(argv[++*i]);
+        return h->warmup >= 0 ? 1 : -1;
+    }
+    if (strcmp(arg, "--trials") == 0) {
+        h->trials = atoi(argv[++*i]);
+        return h->trials >= 1 && h->trials <= HARNESS_MAX_TRIALS ? 1 : -1;
+    }
+    if (strcmp(arg, "--output") == 0) {
+        h->output = argv[++*i];
+        return 1;
+    }
+    return 0;
+}
+
+static inline const char *harness_usage(void) {
+    return "[--warmup N] [--trials N] [--output FILE.csv|FILE.json] [--counters]";
+}
+
+static inline void harness_sample(double *samples, int trial, double seconds) {
+    if (trial >= 0 && trial < HARNESS_MAX_TRIALS) samples[trial] = seconds;
+}
+
+// Counter snapshot before a timed trial; attaches threads started since
+// the last trial. Warmup trials are not counted.
+static inline void harness_counters_start(harness_t *h, int trial) {
+    if (!h->counters || trial < 0) return;
+    counters_attach(&h->counter_set);
+    counters_read(&h->counter_set, h->counter_start);
+}
+
+// Add the counts since harness_counters_start to the region's totals
+static inline void harness_counters_stop(harness_t *h, int trial, harness_counters_t *c) {
+    static double now[COUNTERS_MAX_THREADS][NUM_COUNTERS];
+    if (!h->counters || trial < 0 || c == NULL) return;
+    counters_read(&h->counter_set, now);
+    for (int t = 0; t < h->counter_set.num_threads; t++) {
+        for (int k = 0; k < NUM_COUNTERS; k++) {
+            c->per_thread[t][k] += now[t][k] - h->counter_start[t][k];
+        }
+    }
+    c->trials++;
+}
+
+// Start a timed trial: counters first, then the clock
+static inline double harness_start(harness_t *h, int trial) {
+    harness_counters_start(h, trial);
+    return harness_now();
+}
+
+// End a timed trial: the clock first, then the counters
+static inline void harness_stop(harness_t *h, int trial, double start, double *samples,
+                                harness_counters_t *c) {
+    double elapsed = harness_now() - start;
+    harness_counters_stop(h, trial, c);
+    harness_sample(samples, trial, elapsed);
+}
+
+static inline int harness_compare(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Linear interpolation between closest ranks of a sorted sample
+static inline double harness_quantile(const double *sorted, int n, double q) {
+    double pos = q * (n - 1);
+    int lo = (int)pos;
+    if (lo + 1 >= n) return sorted[n - 1];
+    return sorted[lo] + (pos - lo) * (sorted[lo + 1] - sorted[lo]);
+}
+
+static inline void harness_summarize(const double *samples, int n, harness_stats_t *s) {
+    double sorted[HARNESS_MAX_TRIALS];
+
+    memset(s, 0, sizeof(*s));
+    if (n < 1) return;
+    if (n > HARNESS_MAX_TRIALS) n = HARNESS_MAX_TRIALS;
+    memcpy(sorted, samples, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), harness_compare);
+
+    s->trials = n;
+    s->min = sorted[0];
+    s->max = sorted[n - 1];
+    s->median = harness_quantile(sorted, n, 0.5);
+    s->p95 = harness_quantile(sorted, n, 0.95);
+    for (int i = 0; i < n; i++) s->mean += sorted[i];
+    s->mean /= n;
+    for (int i = 0; i < n; i++) s->stddev += (sorted[i] - s->mean) * (sorted[i] - s->mean);
+    s->stddev = n > 1 ? sqrt(s->stddev / (n - 1)) : 0.0;
+
+    double q1 = harness_quantile(sorted, n, 0.25), q3 = harness_quantile(sorted, n, 0.75);
+    double fence = 1.5 * (q3 - q1);
+    for (int i = 0; i < n; i++) {
+        if (sorted[i] < q1 - fence || sorted[i] > q3 + fence) s->outliers++;
+    }
+}
+
+// JSON string body with quotes, backslashes and control characters escaped
+static inline void harness_json_string(FILE *fp, const char *str) {
+    fputc('"', fp);
+    for (const char *p = str != NULL ? str : ""; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\') fprintf(fp, "\\%c", *p);
+        else if ((unsigned char)*p < 0x20) fprintf(fp, "\\u%04x", *p);
+        else fputc(*p, fp);
+    }
+    fputc('"', fp);
+}
+
+// CSV field, quoted when it holds a separator or a quote
+static inline void harness_csv_string(FILE *fp, const char *str) {
+    if (str == NULL) str = "";
+    if (strpbrk(str, ",\"\n") == NULL) {
+        fputs(str, fp);
+        return;
+    }
+    fputc('"', fp);
+    for (const char *p = str; *p != '\0'; p++) {
+        if (*p == '"') fputc('"', fp);
+        fputc(*p, fp);
+    }
+    fputc('"', fp);
+}
+
+static inline void harness_cpu_model(char *model, size_t len) {
+    char line[256];
+    FILE *fp = fopen("/proc/cpuinfo", "r");
+
+    snprintf(model, len, "unknown");
+    if (fp == NULL) return;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char *colon = strchr(line, ':');
+        if (strncmp(line, "model name", 10) == 0 && colon != NULL) {
+            colon += 2;
+            colon[strcspn(colon, "\n")] = '\0';
+            snprintf(model, len, "%s", colon);
+            break;
+        }
+    }
+    fclose(fp);
+}
+
+// Open the counters if asked for (falling back to timing only), then the
+// output file with the host metadata. Returns -1 if the file cannot be
+// created or its extension is neither .csv nor .json.
+static inline int harness_open(harness_t *h) {
+    char host[128] = "unknown", cpu[160], stamp[32], counters[96];
+    struct utsname uts;
+    time_t now = time(NULL);
+
+    if (h->counters && counters_init(&h->counter_set) != 0) {
+        fprintf(stderr, "Hardware counters unavailable (%s), timing only\n",
+                strerror(h->counter_set.error));
+        h->counters = 0;
+        snprintf(counters, sizeof(counters), "unavailable: %s", strerror(h->counter_set.error));
+    } else {
+        snprintf(counters, sizeof(counters), "%s", h->counters ? "on" : "off");
+    }
+    if (h->output == NULL) return 0;
+    const char *dot = strrchr(h->output, '.');
+    if (dot != NULL && strcmp(dot, ".json") == 0) h->format = HARNESS_JSON;
+    else if (dot != NULL && strcmp(dot, ".csv") == 0) h->format = HARNESS_CSV;
+    else return -1;
+    h->fp = fopen(h->output, "w");
+    if (h->fp == NULL) return -1;
+
+    gethostname(host, sizeof(host) - 1);
+    harness_cpu_model(cpu, sizeof(cpu));
+    if (uname(&uts) != 0) memset(&uts, 0, sizeof(uts));
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (h->format == HARNESS_JSON) {
+        fprintf(h->fp, "{\n  \"program\": ");
+        harness_json_string(h->fp, h->program);
+        fprintf(h->fp, ",\n  \"host\": {\"hostname\": ");
+        harness_json_string(h->fp, host);
+        fprintf(h->fp, ", \"cpu\": ");
+        harness_json_string(h->fp, cpu);
+        fprintf(h->fp, ", \"cpus\": %ld, \"kernel\": ", cpus);
+        harness_json_string(h->fp, uts.release);
+        fprintf(h->fp, ", \"machine\": ");
+        harness_json_string(h->fp, uts.machine);
+        fprintf(h->fp, ", \"compiler\": ");
+        harness_json_string(h->fp, __VERSION__);
+        fprintf(h->fp, ", \"counters\": ");
+        harness_json_string(h->fp, counters);
+        fprintf(h->fp, "},\n  \"timestamp\": \"%s\",\n  \"warmup\": %d,\n  \"trials\": %d,\n"
+                "  \"results\": [", stamp, h->warmup, h->trials);
+    } else {
+        fprintf(h->fp, "# program=%s hostname=%s cpus=%ld kernel=%s machine=%s timestamp=%s "
+                "warmup=%d trials=%d\n", h->program, host, cpus, uts.release, uts.machine,
+                stamp, h->warmup, h->trials);
+        fprintf(h->fp, "# cpu=%s\n# compiler=%s\n# counters=%s\n", cpu, __VERSION__, counters);
+        fprintf(h->fp, "benchmark,variant,params,size,threads,trials,median,mean,p95,stddev,"
+                "min,max,outliers,rate,unit");
+        for (int k = 0; k < NUM_COUNTERS; k++) fprintf(h->fp, ",%s", counter_names[k]);
+        fprintf(h->fp, ",counted_threads,ipc,gflops,gbs,llc_gbs\n");
+    }
+    return 0;
+}
+
+// Per-trial means of a region's counters, summed over its threads. Returns
+// the number of threads that counted any cycles (0: no counters).
+static inline int harness_counter_totals(const harness_t *h, const harness_counters_t *c,
+                                         double *total) {
+    int counted = 0;
+    memset(total, 0, NUM_COUNTERS * sizeof(double));
+    if (!h->counters || c == NULL || c->trials == 0) return 0;
+    for (int t = 0; t < h->counter_set.num_threads; t++) {
+        if (c->per_thread[t][COUNTER_CYCLES] <= 0.0) continue;
+        counted++;
+        for (int k = 0; k < NUM_COUNTERS; k++) total[k] += c->per_thread[t][k] / c->trials;
+    }
+    return counted;
+}
+
+// Empty CSV field (or JSON null) when the value is not known
+static inline void harness_optional(FILE *fp, harness_format_t format, int known, double value) {
+    if (known) fprintf(fp, "%.6g", value);
+    else if (format == HARNESS_JSON) fputs("null", fp);
+}
+
+static inline void harness_emit(harness_t *h, const harness_record_t *r, const harness_stats_t *s) {
+    if (h->fp == NULL) return;
+    double rate = r->work > 0.0 && s->median > 0.0 ? r->work / s->median : 0.0;
+    int is_flops = r->unit != NULL && strcmp(r->unit, "GFLOP/s") == 0;
+    int is_bytes = r->unit != NULL && strcmp(r->unit, "GB/s") == 0;
+    double total[NUM_COUNTERS];
+    int counted = harness_counter_totals(h, r->counters, total);
+    double ipc = total[COUNTER_CYCLES] > 0.0 ? total[COUNTER_INSTRUCTIONS] / total[COUNTER_CYCLES] : 0.0;
+    double llc_gbs = s->median > 0.0 ? total[COUNTER_LLC_MISSES] * HARNESS_CACHE_LINE / s->median * 1e-9 : 0.0;
+
+    if (h->format == HARNESS_JSON) {
+        fprintf(h->fp, "%s\n    {\"benchmark\": ", h->records > 0 ? "," : "");
+        harness_json_string(h->fp, r->benchmark);
+        fprintf(h->fp, ", \"variant\": ");
+        harness_json_string(h->fp, r->variant);
+        fprintf(h->fp, ", \"params\": ");
+        harness_json_string(h->fp, r->params);
+        fprintf(h->fp, ", \"size\": %lld, \"threads\": %d, \"trials\": %d, \"median\": %.9g, "
+                "\"mean\": %.9g, \"p95\": %.9g, \"stddev\": %.9g, \"min\": %.9g, \"max\": %.9g, "
+                "\"outliers\": %d, \"rate\": %.6g, \"unit\": ",
+                r->size, r->threads, s->trials, s->median, s->mean, s->p95, s->stddev,
+                s->min, s->max, s->outliers, rate);
+        harness_json_string(h->fp, r->unit);
+        fprintf(h->fp, ", \"gflops\": ");
+        harness_optional(h->fp, h->format, is_flops, rate);
+        fprintf(h->fp, ", \"gbs\": ");
+        harness_optional(h->fp, h->format, is_bytes, rate);
+        if (counted > 0) {
+            fprintf(h->fp, ", \"counters\": {");
+            for (int k = 0; k < NUM_COUNTERS; k++) {
+                fprintf(h->fp, "\"%s\": %.6g, ", counter_names[k], total[k]);
+            }
+            fprintf(h->fp, "\"ipc\": %.4g, \"llc_gbs\": %.6g, \"per_thread\": [", ipc, llc_gbs);
+            int first = 1;
+            for (int t = 0; t < h->counter_set.num_threads; t++) {
+                const double *v = r->counters->per_thread[t];
+                if (v[COUNTER_CYCLES] <= 0.0) continue;
+                fprintf(h->fp, "%s{\"tid\": %d", first ? "" : ", ", h->counter_set.threads[t].tid);
+                for (int k = 0; k < NUM_COUNTERS; k++) {
+                    fprintf(h->fp, ", \"%s\": %.6g", counter_names[k], v[k] / r->counters->trials);
+                }
+                fprintf(h->fp, "}");
+                first = 0;
+            }
+            fprintf(h->fp, "]}");
+        }
+        fprintf(h->fp, "}");
+    } else {
+        harness_csv_string(h->fp, r->benchmark);
+        fputc(',', h->fp);
+        harness_csv_string(h->fp, r->variant);
+        fputc(',', h->fp);
+        harness_csv_string(h->fp, r->params);
+        fprintf(h->fp, ",%lld,%d,%d,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%d,%.6g,", r->size, r->threads,
+                s->trials, s->median, s->mean, s->p95, s->stddev, s->min, s->max, s->outliers, rate);
+        harness_csv_string(h->fp, r->unit);
+        for (int k = 0; k < NUM_COUNTERS; k++) {
+            fputc(',', h->fp);
+            harness_optional(h->fp, h->format, counted > 0, total[k]);
+        }
+        fprintf(h->fp, ",%d,", counted);
+        harness_optional(h->fp, h->format, counted > 0, ipc);
+        fputc(',', h->fp);
+        harness_optional(h->fp, h->format, is_flops, rate);
+        fputc(',', h->fp);
+        harness_optional(h->fp, h->format, is_bytes, rate);
+        fputc(',', h->fp);
+        harness_optional(h->fp, h->format, counted > 0, llc_gbs);
+        fputc('\n', h->fp);
+    }
+    h->records++;
+}
+
+static inline void harness_close(harness_t *h) {
+    if (h->counters) counters_close(&h->counter_set);
+    if (h->fp == NULL) return;
+    if (h->format == HARNESS_JSON) fprintf(h->fp, "\n  ]\n}\n");
+    fclose(h->fp);
+    h->fp = NULL;
+}
+
+#endif // HARNESS_H
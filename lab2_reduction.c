@@ -1,14 +1,31 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <omp.h>
 #include <time.h>
 #include <math.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-// Function to initialize array with random values
-void initialize_array(double *array, long long size) {
-    #pragma omp parallel for
-    for (long long i = 0; i < size; i++) {
-        array[i] = (double)rand() / RAND_MAX * 1000.0; // Values between 0-1000
+#include "placement.h"
+#include "prng.h"
+#include "reduce.h"
+#include "scan.h"
+#include "harness.h"
+
+// Function to initialize array with random values between 0 and 1000
+// Element i is a pure function of (seed, i), so the data is identical for
+// every thread count. schedule(static) over blocks follows the reduction
+// loops, so with a placement active each page is first touched by
+// (almost always) the thread that later reads it
+void initialize_array(double *array, long long size, uint64_t seed) {
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < size; i += PRNG_FILL_BLOCK) {
+        long long count = size - i < PRNG_FILL_BLOCK ? size - i : PRNG_FILL_BLOCK;
+        prng_fill_uniform(array + i, count, seed, 0, i, 0.0, 1000.0);
     }
 }
 
@@ -24,27 +41,27 @@ double sequential_sum(double *array, long long size) {
 // Method 1: Reduction clause
 double reduction_sum(double *array, long long size, double *computation_time) {
     double sum = 0.0;
-    double start_time = omp_get_wtime();
+    double start_time = harness_now();
     
-    #pragma omp parallel for reduction(+:sum)
+    #pragma omp parallel for schedule(static) reduction(+:sum)
     for (long long i = 0; i < size; i++) {
         sum += array[i];
     }
     
-    *computation_time = omp_get_wtime() - start_time;
+    *computation_time = harness_now() - start_time;
     return sum;
 }
 
 // Method 2: Critical section
 double critical_sum(double *array, long long size, double *computation_time) {
     double sum = 0.0;
-    double start_time = omp_get_wtime();
+    double start_time = harness_now();
     
     #pragma omp parallel
     {
         double local_sum = 0.0;
         
-        #pragma omp for
+        #pragma omp for schedule(static)
         for (long long i = 0; i < size; i++) {
             local_sum += array[i];
         }
@@ -55,29 +72,29 @@ double critical_sum(double *array, long long size, double *computation_time) {
         }
     }
     
-    *computation_time = omp_get_wtime() - start_time;
+    *computation_time = harness_now() - start_time;
     return sum;
 }
 
 // Method 3: Atomic operations
 double atomic_sum(double *array, long long size, double *computation_time) {
     double sum = 0.0;
-    double start_time = omp_get_wtime();
+    double start_time = harness_now();
     
-    #pragma omp parallel for
+    #pragma omp parallel for schedule(static)
     for (long long i = 0; i < size; i++) {
         #pragma omp atomic
         sum += array[i];
     }
     
-    *computation_time = omp_get_wtime() - start_time;
+    *computation_time = harness_now() - start_time;
     return sum;
 }
 
 // Method 4: Manual reduction with private arrays
 double manual_reduction_sum(double *array, long long size, double *computation_time) {
     double sum = 0.0;
-    double start_time = omp_get_wtime();
+    double start_time = harness_now();
     
     #pragma omp parallel
     {
@@ -101,7 +118,7 @@ double manual_reduction_sum(double *array, long long size, double *computation_t
         }
     }
     
-    *computation_time = omp_get_wtime() - start_time;
+    *computation_time = harness_now() - start_time;
     return sum;
 }
 
@@ -111,13 +128,13 @@ double lock_sum(double *array, long long size, double *computation_time) {
     omp_lock_t lock;
     omp_init_lock(&lock);
     
-    double start_time = omp_get_wtime();
+    double start_time = harness_now();
     
     #pragma omp parallel
     {
         double local_sum = 0.0;
         
-        #pragma omp for
+        #pragma omp for schedule(static)
         for (long long i = 0; i < size; i++) {
             local_sum += array[i];
         }
@@ -127,20 +144,1150 @@ double lock_sum(double *array, long long size, double *computation_time) {
         omp_unset_lock(&lock);
     }
     
-    *computation_time = omp_get_wtime() - start_time;
+    *computation_time = harness_now() - start_time;
     omp_destroy_lock(&lock);
     return sum;
 }
 
-void print_results(const char* method, double time, double base_time, double sum, double expected_sum) {
-    double error = fabs(sum - expected_sum) / expected_sum * 100.0;
+// ---------------------------------------------------------------------------
+// SIMD multi-accumulator kernels
+//
+// A plain `sum += a[i]` loop waits on one FP add per element. These kernels
+// keep SUM_ACCUMULATORS independent vector accumulators so the adds overlap
+// and a single thread can keep up with memory. The compensated variant
+// tracks each accumulator's rounding error exactly (TwoSum), so the result
+// no longer depends on how the array is split.
+// ---------------------------------------------------------------------------
+
+#define SUM_ACCUMULATORS 4
+#define REPRO_BLOCK 8192 // fixed summation unit of the compensated method
+
+// A sum with its running rounding error; value = sum + comp
+typedef struct {
+    double sum;
+    double comp;
+} compensated_t;
+
+// Knuth's TwoSum: s + e == a + b exactly
+static inline void two_sum(double a, double b, double *s, double *e) {
+    double t = a + b;
+    double z = t - a;
+    *e = (a - (t - z)) + (b - z);
+    *s = t;
+}
+
+static inline void compensated_add(compensated_t *acc, double x) {
+    double e;
+    two_sum(acc->sum, x, &acc->sum, &e);
+    acc->comp += e;
+}
+
+static inline compensated_t compensated_merge(compensated_t a, compensated_t b) {
+    compensated_t r;
+    double e;
+    two_sum(a.sum, b.sum, &r.sum, &e);
+    r.comp = a.comp + b.comp + e;
+    return r;
+}
+
+typedef double (*sum_block_fn)(const double *a, long long n);
+typedef compensated_t (*compensated_block_fn)(const double *a, long long n);
+
+// Both kernels for one vector width. Lanes are folded in a fixed order, so
+// a given ISA always produces the same bits for the same block.
+#define DEFINE_SUM_KERNELS(SUFFIX, TARGET, LANES)                                        \
+typedef double vsum_##SUFFIX __attribute__((vector_size(LANES * sizeof(double))));       \
+                                                                                         \
+TARGET static double sum_block_##SUFFIX(const double *a, long long n) {                  \
+    vsum_##SUFFIX acc[SUM_ACCUMULATORS] = {{0}};                                         \
+    long long i = 0;                                                                     \
+    for (; i + SUM_ACCUMULATORS * LANES <= n; i += SUM_ACCUMULATORS * LANES) {           \
+        for (int k = 0; k < SUM_ACCUMULATORS; k++) {                                     \
+            vsum_##SUFFIX v;                                                             \
+            memcpy(&v, a + i + k * LANES, sizeof(v));                                    \
+            acc[k] += v;                                                                 \
+        }                                                                                \
+    }                                                                                    \
+    double sum = 0.0;                                                                    \
+    for (int k = 0; k < SUM_ACCUMULATORS; k++) {                                         \
+        for (int l = 0; l < LANES; l++) sum += acc[k][l];                                \
+    }                                                                                    \
+    for (; i < n; i++) sum += a[i];                                                      \
+    return sum;                                                                          \
+}                                                                                        \
+                                                                                         \
+TARGET static compensated_t compensated_block_##SUFFIX(const double *a, long long n) {    \
+    vsum_##SUFFIX s[SUM_ACCUMULATORS] = {{0}}, c[SUM_ACCUMULATORS] = {{0}};              \
+    long long i = 0;                                                                     \
+    for (; i + SUM_ACCUMULATORS * LANES <= n; i += SUM_ACCUMULATORS * LANES) {           \
+        for (int k = 0; k < SUM_ACCUMULATORS; k++) {                                     \
+            vsum_##SUFFIX x;                                                             \
+            memcpy(&x, a + i + k * LANES, sizeof(x));                                    \
+            vsum_##SUFFIX t = s[k] + x;                                                  \
+            vsum_##SUFFIX z = t - s[k];                                                  \
+            c[k] += (s[k] - (t - z)) + (x - z);                                          \
+            s[k] = t;                                                                    \
+        }                                                                                \
+    }                                                                                    \
+    compensated_t acc = {0.0, 0.0};                                                      \
+    for (int k = 0; k < SUM_ACCUMULATORS; k++) {                                         \
+        for (int l = 0; l < LANES; l++) {                                                \
+            compensated_add(&acc, s[k][l]);                                              \
+            acc.comp += c[k][l];                                                         \
+        }                                                                                \
+    }                                                                                    \
+    for (; i < n; i++) compensated_add(&acc, a[i]);                                      \
+    return acc;                                                                          \
+}
+
+DEFINE_SUM_KERNELS(scalar, , 1)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_SUM_KERNELS 1
+DEFINE_SUM_KERNELS(avx2, __attribute__((target("avx2"))), 4)
+DEFINE_SUM_KERNELS(avx512, __attribute__((target("avx512f"))), 8)
+#endif
+
+typedef struct {
+    const char *name;
+    sum_block_fn sum;
+    compensated_block_fn compensated;
+} sum_kernel_t;
+
+// Ordered from most to least preferred
+static const sum_kernel_t sum_kernels[] = {
+#ifdef HAVE_X86_SUM_KERNELS
+    {"avx512", sum_block_avx512, compensated_block_avx512},
+    {"avx2", sum_block_avx2, compensated_block_avx2},
+#endif
+    {"scalar", sum_block_scalar, compensated_block_scalar},
+};
+
+// Best kernel set this CPU supports, chosen once from CPUID
+const sum_kernel_t *select_sum_kernel(void) {
+#ifdef HAVE_X86_SUM_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return &sum_kernels[0];
+    if (__builtin_cpu_supports("avx2")) return &sum_kernels[1];
+#endif
+    return &sum_kernels[sizeof(sum_kernels) / sizeof(sum_kernels[0]) - 1];
+}
+
+// Method 6: SIMD multi-accumulator kernel on each thread's static share
+double simd_sum(double *array, long long size, double *computation_time) {
+    const sum_kernel_t *kernel = select_sum_kernel();
+    double sum = 0.0;
+    double start_time = harness_now();
+    
+    #pragma omp parallel reduction(+:sum)
+    {
+        int num_threads = omp_get_num_threads();
+        int thread_id = omp_get_thread_num();
+        long long start = size * thread_id / num_threads;
+        long long end = size * (thread_id + 1) / num_threads;
+        sum += kernel->sum(array + start, end - start);
+    }
+    
+    *computation_time = harness_now() - start_time;
+    return sum;
+}
+
+// Method 7: Compensated, thread-count independent. The array is cut into
+// fixed REPRO_BLOCK pieces whatever the team size; each piece is summed
+// with error tracking, and the pieces are merged pairwise in index order.
+double compensated_sum(double *array, long long size, double *computation_time) {
+    const sum_kernel_t *kernel = select_sum_kernel();
+    long long num_blocks = (size + REPRO_BLOCK - 1) / REPRO_BLOCK;
+    compensated_t *blocks = (compensated_t *)malloc((num_blocks > 0 ? num_blocks : 1) * sizeof(compensated_t));
+    double start_time = harness_now();
+    
+    #pragma omp parallel for schedule(static)
+    for (long long b = 0; b < num_blocks; b++) {
+        long long start = b * REPRO_BLOCK;
+        long long count = size - start < REPRO_BLOCK ? size - start : REPRO_BLOCK;
+        blocks[b] = kernel->compensated(array + start, count);
+    }
+    
+    // Pairwise merge: stride doubles each pass, same tree for any team
+    for (long long stride = 1; stride < num_blocks; stride *= 2) {
+        #pragma omp parallel for schedule(static) if(num_blocks / stride > 1024)
+        for (long long b = 0; b < num_blocks - stride; b += 2 * stride) {
+            blocks[b] = compensated_merge(blocks[b], blocks[b + stride]);
+        }
+    }
+    double sum = num_blocks > 0 ? blocks[0].sum + blocks[0].comp : 0.0;
+    
+    *computation_time = harness_now() - start_time;
+    free(blocks);
+    return sum;
+}
+
+// Method 8: Lock-free tree combine. Every thread parks its partial in its
+// own cache line, then log2(threads) rounds of pairwise adds (one barrier
+// each) leave the total in slot 0. Slots are ordered by NUMA node, so the
+// early rounds pair threads of the same node. Pairs stay on one socket only
+// while each node's thread count is a power of two; otherwise some early
+// rounds already cross sockets.
+typedef struct {
+    _Alignas(REDUCE_CACHE_LINE) double value;
+} padded_double_t;
+
+double tree_sum(double *array, long long size, double *computation_time,
+                const placement_t *placement) {
+    int max_threads = omp_get_max_threads(); // the team is never larger
+    padded_double_t *slots = (padded_double_t *)aligned_alloc(REDUCE_CACHE_LINE,
+                                                              max_threads * sizeof(padded_double_t));
+    int *position = (int *)malloc(max_threads * sizeof(int)); // thread -> slot
+    if (slots == NULL || position == NULL) {
+        printf("Tree sum: memory allocation failed\n");
+        free(slots);
+        free(position);
+        *computation_time = 0.0;
+        return NAN;
+    }
+    
+    int num_threads = 1;
+    double start_time = harness_now();
+    
+    #pragma omp parallel
+    {
+        // The runtime may hand out fewer threads than asked for, so the
+        // slot order and the tree follow the team actually running
+        #pragma omp single
+        {
+            num_threads = omp_get_num_threads();
+            int next = 0;
+            for (int node = 0; node < placement->num_nodes; node++) {
+                for (int t = 0; t < num_threads; t++) {
+                    int thread_node = placement->mode == PLACEMENT_NONE ? 0 : placement_node(placement, t);
+                    if (thread_node == node) position[t] = next++;
+                }
+            }
+        }
+        
+        int thread_id = omp_get_thread_num();
+        int slot = position[thread_id];
+        double local_sum = 0.0;
+        
+        #pragma omp for schedule(static) nowait
+        for (long long i = 0; i < size; i++) {
+            local_sum += array[i];
+        }
+        slots[slot].value = local_sum;
+        
+        for (int stride = 1; stride < num_threads; stride *= 2) {
+            #pragma omp barrier
+            if (slot % (2 * stride) == 0 && slot + stride < num_threads) {
+                slots[slot].value += slots[slot + stride].value;
+            }
+        }
+    }
+    double sum = slots[0].value;
+    
+    *computation_time = harness_now() - start_time;
+    free(slots);
+    free(position);
+    return sum;
+}
+
+// Serial reference with full error compensation, accurate to about one
+// rounding of the true sum whatever the data
+double reference_sum(double *array, long long size) {
+    compensated_t acc = {0.0, 0.0};
+    for (long long i = 0; i < size; i++) {
+        compensated_add(&acc, array[i]);
+    }
+    return acc.sum + acc.comp;
+}
+
+// Pin every thread of the current team size to its placement CPU. OpenMP
+// keeps its worker threads alive, so the binding holds for later regions.
+void apply_placement(const placement_t *placement) {
+    if (placement->mode == PLACEMENT_NONE) return;
+
+    #pragma omp parallel
+    {
+        placement_pin_self(placement, omp_get_thread_num());
+    }
+}
+
+// Static-partition sum where each thread times its own share, so traffic
+// can be attributed to the NUMA node the thread runs on
+double numa_sum(double *array, long long size, double *thread_bytes, double *thread_seconds) {
+    double sum = 0.0;
+
+    #pragma omp parallel reduction(+:sum)
+    {
+        int thread_id = omp_get_thread_num();
+        long long count = 0;
+        double start_time = harness_now();
+
+        #pragma omp for schedule(static) nowait
+        for (long long i = 0; i < size; i++) {
+            sum += array[i];
+            count++;
+        }
+
+        thread_seconds[thread_id] = harness_now() - start_time;
+        thread_bytes[thread_id] = (double)count * sizeof(double);
+    }
+    return sum;
+}
+
+void print_numa_analysis(const placement_t *placement, uint64_t seed) {
+    long long size = 50000000;
+    int num_threads = omp_get_max_threads();
+    double *array = (double*)malloc(size * sizeof(double));
+    double *thread_bytes = (double*)calloc(num_threads, sizeof(double));
+    double *thread_seconds = (double*)calloc(num_threads, sizeof(double));
+
+    printf("\nNUMA PLACEMENT ANALYSIS (Array size: 50,000,000)\n");
+    printf("==================================================\n");
+    printf("Placement: %s, %d threads over %d CPUs on %d node(s)\n",
+           placement_mode_name(placement->mode), num_threads,
+           placement->num_cpus, placement->num_nodes);
+
+    if (array == NULL || thread_bytes == NULL || thread_seconds == NULL) {
+        printf("Memory allocation failed\n");
+    } else {
+        apply_placement(placement);
+        initialize_array(array, size, seed);
+        placement_print_pages(placement, "Array", array, size * sizeof(double));
+
+        numa_sum(array, size, thread_bytes, thread_seconds); // warm caches and TLB
+        numa_sum(array, size, thread_bytes, thread_seconds);
+        placement_print_bandwidth(placement, "Reduction read", num_threads,
+                                  thread_bytes, thread_seconds);
+    }
+
+    free(array);
+    free(thread_bytes);
+    free(thread_seconds);
+}
+
+// ---------------------------------------------------------------------------
+// Reduction library benchmark (reduce.h): one table per operation
+// ---------------------------------------------------------------------------
+
+#define HISTOGRAM_BUCKETS 64
+#define HISTOGRAM_LO 0.0
+#define HISTOGRAM_HI 1000.0
+
+typedef struct {
+    const double *f64;
+    const int64_t *i64;
+    long long size;
+} library_input_t;
+
+typedef struct {
+    double lo, hi;              // sum in lo, or min / max
+    int64_t ilo, ihi;           // integer sum in ilo, or min / max
+    reduce_arg_t arg_lo, arg_hi;
+    reduce_moments_t moments;
+    long long counts[HISTOGRAM_BUCKETS];
+} library_result_t;
+
+// run is the timed parallel call; check recomputes serially, formats the
+// parallel result into text and returns 1 if the two agree
+typedef struct {
+    const char *name;
+    int bytes_per_element;      // bytes read per element, over all passes
+    void (*run)(const library_input_t *in, library_result_t *r);
+    int (*check)(const library_input_t *in, const library_result_t *r, char *text, size_t len);
+} library_op_t;
+
+static void run_sum_f64(const library_input_t *in, library_result_t *r) {
+    r->lo = reduce_sum_f64(in->f64, in->size);
+}
+
+static int check_sum_f64(const library_input_t *in, const library_result_t *r, char *text, size_t len) {
+    double ref = reference_sum((double *)in->f64, in->size);
+    snprintf(text, len, "%.6f", r->lo);
+    return fabs(r->lo - ref) <= 1e-12 * fabs(ref);
+}
+
+static void run_sum_i64(const library_input_t *in, library_result_t *r) {
+    r->ilo = reduce_sum_i64(in->i64, in->size);
+}
+
+static int check_sum_i64(const library_input_t *in, const library_result_t *r, char *text, size_t len) {
+    int64_t ref = 0;
+    for (long long i = 0; i < in->size; i++) ref += in->i64[i];
+    snprintf(text, len, "%lld", (long long)r->ilo);
+    return r->ilo == ref;
+}
+
+static void run_min_max_f64(const library_input_t *in, library_result_t *r) {
+    r->lo = reduce_min_f64(in->f64, in->size);
+    r->hi = reduce_max_f64(in->f64, in->size);
+}
+
+static int check_min_max_f64(const library_input_t *in, const library_result_t *r, char *text, size_t len) {
+    double lo = in->f64[0], hi = in->f64[0];
+    for (long long i = 1; i < in->size; i++) {
+        if (in->f64[i] < lo) lo = in->f64[i];
+        if (in->f64[i] > hi) hi = in->f64[i];
+    }
+    snprintf(text, len, "%.6f / %.6f", r->lo, r->hi);
+    return r->lo == lo && r->hi == hi;
+}
+
+static void run_min_max_i64(const library_input_t *in, library_result_t *r) {
+    r->ilo = reduce_min_i64(in->i64, in->size);
+    r->ihi = reduce_max_i64(in->i64, in->size);
+}
+
+static int check_min_max_i64(const library_input_t *in, const library_result_t *r, char *text, size_t len) {
+    int64_t lo = in->i64[0], hi = in->i64[0];
+    for (long long i = 1; i < in->size; i++) {
+        if (in->i64[i] < lo) lo = in->i64[i];
+        if (in->i64[i] > hi) hi = in->i64[i];
+    }
+    snprintf(text, len, "%lld / %lld", (long long)r->ilo, (long long)r->ihi);
+    return r->ilo == lo && r->ihi == hi;
+}
+
+static void run_argmin_argmax(const library_input_t *in, library_result_t *r) {
+    r->arg_lo = reduce_argmin_f64(in->f64, in->size);
+    r->arg_hi = reduce_argmax_f64(in->f64, in->size);
+}
+
+static int check_argmin_argmax(const library_input_t *in, const library_result_t *r, char *text, size_t len) {
+    long long lo = 0, hi = 0;
+    for (long long i = 1; i < in->size; i++) {
+        if (in->f64[i] < in->f64[lo]) lo = i;
+        if (in->f64[i] > in->f64[hi]) hi = i;
+    }
+    snprintf(text, len, "@%lld / @%lld", r->arg_lo.index, r->arg_hi.index);
+    return r->arg_lo.index == lo && r->arg_hi.index == hi;
+}
+
+static void run_mean_variance(const library_input_t *in, library_result_t *r) {
+    r->moments = reduce_moments_f64(in->f64, in->size);
+}
+
+// Two-pass compensated reference
+static int check_mean_variance(const library_input_t *in, const library_result_t *r, char *text, size_t len) {
+    double mean = reference_sum((double *)in->f64, in->size) / in->size;
+    compensated_t squares = {0.0, 0.0};
+    for (long long i = 0; i < in->size; i++) {
+        double d = in->f64[i] - mean;
+        compensated_add(&squares, d * d);
+    }
+    double var = in->size > 1 ? (squares.sum + squares.comp) / (in->size - 1) : 0.0;
+    double got = reduce_variance(r->moments);
+    snprintf(text, len, "%.4f / %.2f", r->moments.mean, got);
+    return fabs(r->moments.mean - mean) <= 1e-10 * fabs(mean) && fabs(got - var) <= 1e-10 * fabs(var);
+}
+
+static void run_histogram(const library_input_t *in, library_result_t *r) {
+    if (reduce_histogram_f64(in->f64, in->size, HISTOGRAM_LO, HISTOGRAM_HI,
+                             HISTOGRAM_BUCKETS, r->counts) != 0) {
+        memset(r->counts, 0, sizeof(r->counts));
+    }
+}
+
+static int check_histogram(const library_input_t *in, const library_result_t *r, char *text, size_t len) {
+    long long counts[HISTOGRAM_BUCKETS] = {0}, fullest = 0;
+    double scale = HISTOGRAM_BUCKETS / (HISTOGRAM_HI - HISTOGRAM_LO);
+    for (long long i = 0; i < in->size; i++) {
+        counts[reduce_bucket(in->f64[i], HISTOGRAM_LO, scale, HISTOGRAM_BUCKETS)]++;
+    }
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        if (r->counts[b] > fullest) fullest = r->counts[b];
+    }
+    snprintf(text, len, "%d buckets, fullest %lld", HISTOGRAM_BUCKETS, fullest);
+    return memcmp(counts, r->counts, sizeof(counts)) == 0;
+}
+
+static const library_op_t library_ops[] = {
+    {"SUM (f64): reduction clause + simd", 8, run_sum_f64, check_sum_f64},
+    {"SUM (int64): reduction clause + simd", 8, run_sum_i64, check_sum_i64},
+    {"MIN / MAX (f64): reduction clauses", 16, run_min_max_f64, check_min_max_f64},
+    {"MIN / MAX (int64): reduction clauses", 16, run_min_max_i64, check_min_max_i64},
+    {"ARGMIN / ARGMAX (f64): declare reduction", 16, run_argmin_argmax, check_argmin_argmax},
+    {"MEAN / VARIANCE (f64): blocked Welford/Chan, padded slots + tree", 8, run_mean_variance, check_mean_variance},
+    {"HISTOGRAM (f64): padded per-thread buckets + parallel merge", 8, run_histogram, check_histogram},
+};
+
+// Time is the median of the harness trials; the serial check runs once
+void print_library_analysis(harness_t *h, const long long *sizes, int num_sizes, uint64_t seed) {
+    int num_ops = sizeof(library_ops) / sizeof(library_ops[0]);
+    
+    printf("\nREDUCTION LIBRARY (reduce.h, %d threads)\n", omp_get_max_threads());
+    printf("==================================================\n");
+    
+    for (int op = 0; op < num_ops; op++) {
+        printf("\n%s\n", library_ops[op].name);
+        printf("-----------------------------------------------------------------------------------\n");
+        printf("| Size         | Time (s)   | GB/s     | Result                          | Check |\n");
+        printf("-----------------------------------------------------------------------------------\n");
+        
+        for (int s = 0; s < num_sizes; s++) {
+            long long size = sizes[s];
+            double *f64 = (double *)malloc(size * sizeof(double));
+            int64_t *i64 = (int64_t *)malloc(size * sizeof(int64_t));
+            if (f64 == NULL || i64 == NULL) {
+                printf("| %12lld | memory allocation failed\n", size);
+                free(f64);
+                free(i64);
+                continue;
+            }
+            initialize_array(f64, size, seed);
+            #pragma omp parallel for schedule(static)
+            for (long long i = 0; i < size; i++) {
+                i64[i] = (int64_t)(f64[i] * 1e6) - 500000000LL;
+            }
+            library_input_t in = {f64, i64, size};
+            library_result_t result;
+            
+            double samples[HARNESS_MAX_TRIALS];
+            harness_counters_t counters = {0};
+            for (int trial = -h->warmup; trial < h->trials; trial++) {
+                double start_time = harness_start(h, trial);
+                library_ops[op].run(&in, &result);
+                harness_stop(h, trial, start_time, samples, &counters);
+            }
+            harness_stats_t stats;
+            harness_summarize(samples, h->trials, &stats);
+            double bytes = (double)size * library_ops[op].bytes_per_element;
+            harness_record_t record = {"reduce", library_ops[op].name, NULL, size,
+                                       omp_get_max_threads(), bytes * 1e-9, "GB/s", &counters};
+            harness_emit(h, &record, &stats);
+            
+            char text[64];
+            int ok = library_ops[op].check(&in, &result, text, sizeof(text));
+            printf("| %12lld | %10.6f | %8.2f | %-31s | %-5s |\n", size, stats.median,
+                   bytes / stats.median * 1e-9, text, ok ? "ok" : "FAIL");
+            
+            free(f64);
+            free(i64);
+        }
+        printf("-----------------------------------------------------------------------------------\n");
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Prefix sums (scan.h): sequential vs three-phase vs decoupled look-back
+// ---------------------------------------------------------------------------
+
+// Type-erased entry points so one table drives both element types
+typedef struct {
+    const char *name;
+    size_t elem_size;
+    void (*convert)(const double *src, void *dst, long long n);
+    void (*sequential)(const void *in, void *out, long long n, int exclusive);
+    void (*three_phase)(const void *in, void *out, long long n, int exclusive);
+    void (*lookback)(const void *in, void *out, long long n, int exclusive);
+    int (*same)(const void *expected, const void *got, long long n);
+} scan_type_t;
+
+#define DEFINE_SCAN_WRAPPERS(SUFFIX, T)                                                   \
+static void scan_seq_##SUFFIX(const void *in, void *out, long long n, int exclusive) {    \
+    scan_serial_##SUFFIX((const T *)in, (T *)out, n, 0, exclusive);                       \
+}                                                                                         \
+static void scan_three_##SUFFIX(const void *in, void *out, long long n, int exclusive) {  \
+    scan_##SUFFIX((const T *)in, (T *)out, n, exclusive);                                 \
+}                                                                                         \
+static void scan_look_##SUFFIX(const void *in, void *out, long long n, int exclusive) {   \
+    scan_lookback_##SUFFIX((const T *)in, (T *)out, n, exclusive);                        \
+}
+
+DEFINE_SCAN_WRAPPERS(f64, double)
+DEFINE_SCAN_WRAPPERS(i64, int64_t)
+
+static void scan_convert_f64(const double *src, void *dst, long long n) {
+    memcpy(dst, src, n * sizeof(double));
+}
+
+// Same integers as the reduction library tables
+static void scan_convert_i64(const double *src, void *dst, long long n) {
+    int64_t *out = (int64_t *)dst;
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < n; i++) out[i] = (int64_t)(src[i] * 1e6) - 500000000LL;
+}
+
+// Parallel scans reassociate the additions, so doubles get a relative bound
+static int scan_same_f64(const void *expected, const void *got, long long n) {
+    const double *e = (const double *)expected, *g = (const double *)got;
+    for (long long i = 0; i < n; i++) {
+        if (fabs(g[i] - e[i]) > 1e-10 * fabs(e[i])) return 0;
+    }
+    return 1;
+}
+
+static int scan_same_i64(const void *expected, const void *got, long long n) {
+    return memcmp(expected, got, n * sizeof(int64_t)) == 0;
+}
+
+static const scan_type_t scan_types[] = {
+    {"f64", sizeof(double), scan_convert_f64, scan_seq_f64, scan_three_f64, scan_look_f64, scan_same_f64},
+    {"int64", sizeof(int64_t), scan_convert_i64, scan_seq_i64, scan_three_i64, scan_look_i64, scan_same_i64},
+};
+
+// Median of the harness trials; in-place trials restore the input untimed first
+static double time_scan(harness_t *h, const char *variant, const scan_type_t *type,
+                        void (*scan)(const void *, void *, long long, int), const void *in,
+                        void *out, long long size, int exclusive, int in_place) {
+    double samples[HARNESS_MAX_TRIALS];
+    harness_counters_t counters = {0};
+    for (int trial = -h->warmup; trial < h->trials; trial++) {
+        if (in_place) memcpy(out, in, size * type->elem_size);
+        double start_time = harness_start(h, trial);
+        scan(in_place ? out : in, out, size, exclusive);
+        harness_stop(h, trial, start_time, samples, &counters);
+    }
+    
+    harness_stats_t stats;
+    char params[64];
+    harness_summarize(samples, h->trials, &stats);
+    snprintf(params, sizeof(params), "type=%s;mode=%s", type->name,
+             exclusive ? "exclusive" : "inclusive");
+    harness_record_t record = {"scan", variant, params, size, omp_get_max_threads(),
+                               2.0 * size * type->elem_size * 1e-9, "GB/s", &counters};
+    harness_emit(h, &record, &stats);
+    return stats.median;
+}
+
+// GB/s counts one read and one write per element
+void print_scan_analysis(harness_t *h, const long long *sizes, int num_sizes, uint64_t seed) {
+    int num_types = sizeof(scan_types) / sizeof(scan_types[0]);
+    
+    printf("\nPREFIX SUM (scan.h, %d threads, look-back tile %d elements)\n",
+           omp_get_max_threads(), SCAN_TILE);
+    printf("==================================================\n");
+    
+    for (int t = 0; t < num_types; t++) {
+        const scan_type_t *type = &scan_types[t];
+        printf("\nSCAN (%s), GB/s\n", type->name);
+        printf("-------------------------------------------------------------------------------------\n");
+        printf("| Size         | Scan      | Sequential | Three-phase | In-place | Look-back | Check |\n");
+        printf("-------------------------------------------------------------------------------------\n");
+        
+        for (int s = 0; s < num_sizes; s++) {
+            long long size = sizes[s];
+            double *values = (double *)malloc(size * sizeof(double));
+            void *in = malloc(size * type->elem_size);
+            void *expected = malloc(size * type->elem_size);
+            void *out = malloc(size * type->elem_size);
+            if (values == NULL || in == NULL || expected == NULL || out == NULL) {
+                printf("| %12lld | memory allocation failed\n", size);
+                free(values);
+                free(in);
+                free(expected);
+                free(out);
+                continue;
+            }
+            initialize_array(values, size, seed);
+            type->convert(values, in, size);
+            
+            for (int exclusive = 0; exclusive <= 1; exclusive++) {
+                double bytes = 2.0 * size * type->elem_size;
+                int ok = 1;
+                
+                double seq_time = time_scan(h, "sequential", type, type->sequential, in, expected,
+                                            size, exclusive, 0);
+                double three_time = time_scan(h, "three-phase", type, type->three_phase, in, out,
+                                              size, exclusive, 0);
+                ok &= type->same(expected, out, size);
+                double in_place_time = time_scan(h, "three-phase in-place", type, type->three_phase,
+                                                 in, out, size, exclusive, 1);
+                ok &= type->same(expected, out, size);
+                double look_time = time_scan(h, "look-back", type, type->lookback, in, out, size,
+                                             exclusive, 0);
+                ok &= type->same(expected, out, size);
+                
+                printf("| %12lld | %-9s | %10.2f | %11.2f | %8.2f | %9.2f | %-5s |\n", size,
+                       exclusive ? "exclusive" : "inclusive", bytes / seq_time * 1e-9,
+                       bytes / three_time * 1e-9, bytes / in_place_time * 1e-9,
+                       bytes / look_time * 1e-9, ok ? "ok" : "FAIL");
+            }
+            
+            free(values);
+            free(in);
+            free(expected);
+            free(out);
+        }
+        printf("-------------------------------------------------------------------------------------\n");
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Streaming reduction: files and pipes of native-endian doubles, reduced in
+// bounded memory
+//
+// The reduction clause combines the threads' partials in an order the
+// runtime chooses, so no stream can promise its bits. The stream instead
+// reproduces blocked_sum: fixed SUM_BLOCK-element blocks, each summed in
+// order, with the block sums added in block order. Every round takes the
+// next chunk of the input, a whole number of SUM_BLOCKs; the team sums the
+// chunk's blocks in parallel and the block sums continue the running total.
+// Files and pipes are both read front to back, so the result is bitwise
+// identical to blocked_sum for either, whatever the team size or slice.
+// ---------------------------------------------------------------------------
+
+#define SUM_BLOCK 4096
+
+static long long sum_blocks(long long size) {
+    return (size + SUM_BLOCK - 1) / SUM_BLOCK;
+}
+
+// sums[k] = array[k * SUM_BLOCK] + ... in order, for every block
+static void block_sums(const double *array, long long size, double *sums) {
+    #pragma omp parallel for schedule(static)
+    for (long long k = 0; k < sum_blocks(size); k++) {
+        long long end = (k + 1) * SUM_BLOCK < size ? (k + 1) * SUM_BLOCK : size;
+        double sum = 0.0;
+        for (long long i = k * SUM_BLOCK; i < end; i++) {
+            sum += array[i];
+        }
+        sums[k] = sum;
+    }
+}
+
+// Sum whose bits depend only on the data: block sums in block order. sums
+// is caller-provided scratch of sum_blocks(size) entries.
+double blocked_sum(const double *array, long long size, double *sums) {
+    double sum = 0.0;
+    block_sums(array, size, sums);
+    for (long long k = 0; k < sum_blocks(size); k++) {
+        sum += sums[k];
+    }
+    return sum;
+}
+
+#define STREAM_SLICE (1 << 17)  // elements per thread per round (1 MB)
+
+typedef enum { STREAM_IO_READ, STREAM_IO_MMAP } stream_io_t;
+
+typedef struct {
+    int fd;
+    int seekable;
+    int num_threads;
+    long long size;                              // elements, seekable input only
+    long long chunk;                             // elements per round
+    double *sums;                                // block sums of one chunk
+
+    // Double buffer shared by the reader thread and the reducing team
+    double *buffers[2];
+    long long counts[2];
+    int filled[2];
+    int finished;                                // reader hit the end or an error
+    int error;
+    int truncated;                               // input ended inside a double
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} stream_t;
+
+// Read until bytes are in or the input ends; offset < 0 reads sequentially.
+// Returns the byte count, or -1 on error.
+static long long stream_read_fully(int fd, void *dst, long long bytes, long long offset) {
+    long long done = 0;
+    while (done < bytes) {
+        ssize_t got = offset < 0 ? read(fd, (char *)dst + done, bytes - done)
+                                 : pread(fd, (char *)dst + done, bytes - done, offset + done);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) return -1;
+        if (got == 0) break;
+        done += got;
+    }
+    return done;
+}
+
+static void *stream_reader(void *arg) {
+    stream_t *st = (stream_t *)arg;
+
+    for (long long round = 0;; round++) {
+        int b = round % 2;
+        pthread_mutex_lock(&st->lock);
+        while (st->filled[b]) pthread_cond_wait(&st->cond, &st->lock);
+        pthread_mutex_unlock(&st->lock);
+
+        long long bytes = stream_read_fully(st->fd, st->buffers[b], st->chunk * sizeof(double), -1);
+        long long total = bytes > 0 ? bytes / (long long)sizeof(double) : 0;
+        st->counts[b] = total;
+
+        pthread_mutex_lock(&st->lock);
+        if (bytes < 0) st->error = 1;
+        if (bytes > 0 && bytes % sizeof(double) != 0) st->truncated = 1;
+        if (total > 0) st->filled[b] = 1;
+        if (bytes < st->chunk * (long long)sizeof(double)) st->finished = 1;
+        pthread_cond_broadcast(&st->cond);
+        pthread_mutex_unlock(&st->lock);
+        if (st->finished) return NULL;
+    }
+}
+
+// Continue the running total over one chunk, block sums in block order
+static double stream_add_chunk(stream_t *st, double total, const double *chunk, long long n) {
+    block_sums(chunk, n, st->sums);
+    for (long long k = 0; k < sum_blocks(n); k++) {
+        total += st->sums[k];
+    }
+    return total;
+}
+
+// read(2) into two buffers while the team reduces the other one
+static int stream_sum_read(stream_t *st, double *result, long long *elements) {
+    double total = 0.0;
+    long long seen = 0;
+    pthread_t reader;
+
+    if (pthread_create(&reader, NULL, stream_reader, st) != 0) return -1;
+
+    for (long long round = 0;; round++) {
+        int b = round % 2;
+        pthread_mutex_lock(&st->lock);
+        while (!st->filled[b] && !st->finished) pthread_cond_wait(&st->cond, &st->lock);
+        int have = st->filled[b];
+        pthread_mutex_unlock(&st->lock);
+        if (!have) break;
+
+        total = stream_add_chunk(st, total, st->buffers[b], st->counts[b]);
+        seen += st->counts[b];
+
+        pthread_mutex_lock(&st->lock);
+        st->filled[b] = 0;
+        pthread_cond_broadcast(&st->cond);
+        pthread_mutex_unlock(&st->lock);
+    }
+    pthread_join(reader, NULL);
+
+    *result = total;
+    *elements = seen;
+    return st->error || st->truncated ? -1 : 0;
+}
+
+// mmap(2) the file; the kernel reads ahead of the next chunk (WILLNEED) and
+// drops the chunk just reduced (DONTNEED), so the resident set stays at
+// about two chunks however large the file is
+static int stream_sum_mmap(stream_t *st, double *result, long long *elements) {
+    long long bytes = st->size * (long long)sizeof(double);
+    long page = sysconf(_SC_PAGESIZE);
+    double total = 0.0;
+
+    if (bytes == 0) {
+        *result = 0.0;
+        *elements = 0;
+        return 0;
+    }
+    double *map = (double *)mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, st->fd, 0);
+    if (map == MAP_FAILED) return -1;
+
+    for (long long first = 0; first < st->size; first += st->chunk) {
+        long long n = st->size - first < st->chunk ? st->size - first : st->chunk;
+        long long next = first + n;
+        if (next < st->size) {
+            long long ahead = st->size - next < st->chunk ? st->size - next : st->chunk;
+            uintptr_t start = (uintptr_t)(map + next) & ~(uintptr_t)(page - 1);
+            madvise((void *)start, (uintptr_t)(map + next + ahead) - start, MADV_WILLNEED);
+        }
+        total = stream_add_chunk(st, total, map + first, n);
+        uintptr_t start = (uintptr_t)(map + first) & ~(uintptr_t)(page - 1);
+        madvise((void *)start, (uintptr_t)(map + next) - start, MADV_DONTNEED);
+    }
+    munmap(map, bytes);
+
+    *result = total;
+    *elements = st->size;
+    return 0;
+}
+
+// Write count elements of the seed's stream, i.e. exactly the array that
+// initialize_array(array, count, seed) builds, one slice at a time
+int make_stream_file(const char *path, long long count, uint64_t seed) {
+    double *buffer = (double *)malloc(STREAM_SLICE * sizeof(double));
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int status = 0;
+
+    if (buffer == NULL || fd < 0) {
+        printf("Cannot create '%s': %s\n", path, strerror(errno));
+        free(buffer);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    for (long long first = 0; first < count && status == 0; first += STREAM_SLICE) {
+        long long n = count - first < STREAM_SLICE ? count - first : STREAM_SLICE;
+        prng_fill_uniform(buffer, n, seed, 0, first, 0.0, 1000.0);
+        for (long long done = 0; done < n * (long long)sizeof(double);) {
+            ssize_t put = write(fd, (char *)buffer + done, n * sizeof(double) - done);
+            if (put < 0 && errno == EINTR) continue;
+            if (put < 0) {
+                printf("Write to '%s' failed: %s\n", path, strerror(errno));
+                status = -1;
+                break;
+            }
+            done += put;
+        }
+    }
+    close(fd);
+    free(buffer);
+    if (status == 0) {
+        printf("Wrote %lld elements (%.2f MB) to %s\n", count,
+               count * sizeof(double) / (1024.0 * 1024.0), path);
+    }
+    return status;
+}
+
+// Load the whole file and reduce it in memory, for --verify only
+static void stream_verify(const char *path, long long size, double stream_result) {
+    double *array = (double *)malloc((size > 0 ? size : 1) * sizeof(double));
+    double *sums = (double *)malloc((size > 0 ? sum_blocks(size) : 1) * sizeof(double));
+    int fd = open(path, O_RDONLY);
+    long long bytes = size * (long long)sizeof(double);
+
+    if (array == NULL || sums == NULL || fd < 0 || stream_read_fully(fd, array, bytes, 0) != bytes) {
+        printf("Verification skipped: cannot load %.2f MB into memory\n", bytes / (1024.0 * 1024.0));
+        free(array);
+        free(sums);
+        if (fd >= 0) close(fd);
+        return;
+    }
+    close(fd);
+
+    double time;
+    double in_memory = blocked_sum(array, size, sums);
+    double clause = reduction_sum(array, size, &time);
+    printf("In-memory blocked_sum:   %.6f  bitwise identical: %s\n", in_memory,
+           memcmp(&in_memory, &stream_result, sizeof(double)) == 0 ? "yes" : "NO");
+    printf("In-memory reduction_sum: %.6f  bitwise identical: %s\n", clause,
+           memcmp(&clause, &stream_result, sizeof(double)) == 0
+               ? "yes" : "no (per-thread partials in runtime order round differently)");
+    free(array);
+    free(sums);
+}
+
+// Reduce path ("-" for stdin) with the current OpenMP team. slice is rounded
+// up to whole SUM_BLOCKs. Returns 0 on success.
+int run_stream(const char *path, stream_io_t io, long long slice, int verify) {
+    stream_t st;
+    struct stat info;
+    int is_stdin = strcmp(path, "-") == 0;
+
+    memset(&st, 0, sizeof(st));
+    st.fd = is_stdin ? STDIN_FILENO : open(path, O_RDONLY);
+    if (st.fd < 0 || fstat(st.fd, &info) != 0) {
+        printf("Cannot open '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+    st.num_threads = omp_get_max_threads();
+    slice = (slice + SUM_BLOCK - 1) / SUM_BLOCK * SUM_BLOCK;
+    st.chunk = st.num_threads * slice;
+    st.seekable = S_ISREG(info.st_mode);
+    if (st.seekable) {
+        st.size = info.st_size / (long long)sizeof(double);
+        if (info.st_size % sizeof(double) != 0) {
+            printf("'%s' is truncated: %lld bytes is not a whole number of doubles\n", path,
+                   (long long)info.st_size);
+            if (!is_stdin) close(st.fd);
+            return -1;
+        }
+    } else if (io == STREAM_IO_MMAP) {
+        printf("'%s' is not a regular file; using read I/O\n", path);
+        io = STREAM_IO_READ;
+    }
+
+    long long buffer_bytes = 0;
+    st.sums = (double *)malloc(st.chunk / SUM_BLOCK * sizeof(double));
+    if (io == STREAM_IO_READ) {
+        buffer_bytes = 2 * st.chunk * (long long)sizeof(double);
+        for (int b = 0; b < 2; b++) {
+            st.buffers[b] = (double *)malloc(st.chunk * sizeof(double));
+        }
+    }
+    if (st.sums == NULL || (io == STREAM_IO_READ && (st.buffers[0] == NULL || st.buffers[1] == NULL))) {
+        printf("Cannot allocate %.2f MB of stream buffers\n", buffer_bytes / (1024.0 * 1024.0));
+        free(st.sums);
+        free(st.buffers[0]);
+        free(st.buffers[1]);
+        if (!is_stdin) close(st.fd);
+        return -1;
+    }
+    if (io == STREAM_IO_READ) {
+        pthread_mutex_init(&st.lock, NULL);
+        pthread_cond_init(&st.cond, NULL);
+    }
+
+    printf("STREAMING REDUCTION (%s)\n", is_stdin ? "stdin" : path);
+    printf("==================================================\n");
+    printf("Input: %s, I/O: %s, threads: %d (OMP_NUM_THREADS, default all cores), slice: %lld elements per thread\n",
+           st.seekable ? "file" : "pipe", io == STREAM_IO_MMAP ? "mmap" : "read",
+           st.num_threads, slice);
+    if (io == STREAM_IO_READ) {
+        printf("Buffers: %.2f MB (two rounds)\n", buffer_bytes / (1024.0 * 1024.0));
+    } else {
+        printf("Resident window: ~%.2f MB (two rounds)\n",
+               2.0 * st.chunk * sizeof(double) / (1024.0 * 1024.0));
+    }
+    printf("Blocks of %d elements folded in order (blocked_sum): the sum does not depend on threads or slice\n",
+           SUM_BLOCK);
+
+    double result = 0.0;
+    long long elements = 0;
+    double start_time = harness_now();
+    int status = io == STREAM_IO_MMAP ? stream_sum_mmap(&st, &result, &elements)
+                                      : stream_sum_read(&st, &result, &elements);
+    double elapsed = harness_now() - start_time;
+
+    if (st.truncated) {
+        printf("Input truncated: it ended inside a double after %lld elements\n", elements);
+    } else if (status != 0) {
+        printf("Stream failed after %lld elements: %s\n", elements, strerror(errno));
+    } else {
+        printf("Elements: %lld (%.2f MB)\n", elements, elements * sizeof(double) / (1024.0 * 1024.0));
+        printf("Time: %.6f s, %.2f GB/s\n", elapsed,
+               elapsed > 0.0 ? elements * sizeof(double) / elapsed * 1e-9 : 0.0);
+        printf("Sum: %.6f\n", result);
+        if (verify && st.seekable) stream_verify(path, st.size, result);
+        else if (verify) printf("Verification skipped: a pipe cannot be read twice\n");
+    }
+
+    if (io == STREAM_IO_READ) {
+        pthread_mutex_destroy(&st.lock);
+        pthread_cond_destroy(&st.cond);
+        free(st.buffers[0]);
+        free(st.buffers[1]);
+    }
+    free(st.sums);
+    if (!is_stdin) close(st.fd);
+    return status;
+}
+
+// Every method of the comparison tables, in the order of the main table
+#define NUM_SUM_METHODS 8
+enum { SUM_REDUCTION, SUM_CRITICAL, SUM_ATOMIC, SUM_MANUAL, SUM_LOCK, SUM_SIMD,
+       SUM_COMPENSATED, SUM_TREE };
+
+static const char *const sum_method_names[NUM_SUM_METHODS] = {
+    "Reduction", "Critical Section", "Atomic", "Manual", "Lock", "SIMD", "Compensated",
+    "Tree (padded)",
+};
+
+static double run_sum_method(int method, double *array, long long size, double *time,
+                             const placement_t *placement) {
+    switch (method) {
+        case SUM_REDUCTION:   return reduction_sum(array, size, time);
+        case SUM_CRITICAL:    return critical_sum(array, size, time);
+        case SUM_ATOMIC:      return atomic_sum(array, size, time);
+        case SUM_MANUAL:      return manual_reduction_sum(array, size, time);
+        case SUM_LOCK:        return lock_sum(array, size, time);
+        case SUM_SIMD:        return simd_sum(array, size, time);
+        case SUM_COMPENSATED: return compensated_sum(array, size, time);
+        default:              return tree_sum(array, size, time, placement);
+    }
+}
+
+// warmup + trials rounds over all methods, interleaved so that drift in the
+// machine's state hits every method alike. sums holds the last round's
+// results; each method's times are emitted as one harness record.
+static void time_sum_methods(harness_t *h, const char *benchmark, double *array, long long size,
+                             const placement_t *placement, harness_stats_t *stats, double *sums) {
+    static double samples[NUM_SUM_METHODS][HARNESS_MAX_TRIALS];
+    static harness_counters_t counters[NUM_SUM_METHODS];
+    
+    memset(counters, 0, sizeof(counters));
+    for (int trial = -h->warmup; trial < h->trials; trial++) {
+        for (int m = 0; m < NUM_SUM_METHODS; m++) {
+            double time;
+            harness_counters_start(h, trial);
+            sums[m] = run_sum_method(m, array, size, &time, placement);
+            harness_counters_stop(h, trial, &counters[m]);
+            harness_sample(samples[m], trial, time);
+        }
+    }
+    for (int m = 0; m < NUM_SUM_METHODS; m++) {
+        harness_summarize(samples[m], h->trials, &stats[m]);
+        harness_record_t record = {benchmark, sum_method_names[m], NULL, size,
+                                   omp_get_max_threads(), size * sizeof(double) * 1e-9, "GB/s",
+                                   &counters[m]};
+        harness_emit(h, &record, &stats[m]);
+    }
+}
+
+// Error is relative to the compensated reference, so 0 means exact to the
+// last bit of a correctly rounded sum
+void print_results(const char* method, double time, double base_time, double sum,
+                   double expected_sum, long long size) {
+    double error = fabs(sum - expected_sum) / expected_sum;
     double speedup = base_time / time;
+    double bandwidth = size * sizeof(double) / time * 1e-9;
     
-    printf("| %-20s | %10.6f | %8.2fx | %12.2f | %8.4f%% |\n", 
-           method, time, speedup, sum, error);
+    printf("| %-20s | %10.6f | %8.2fx | %8.2f | %18.6f | %9.2e |\n", 
+           method, time, speedup, bandwidth, sum, error);
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    // Optional: --placement none|compact|scatter|<cpu-list>, --seed N,
+    // streaming: --stream FILE|- [--io read|mmap] [--slice N] [--verify],
+    // --make-stream FILE --count N, harness: --warmup N --trials N --output FILE
+    harness_t harness;
+    harness_init(&harness, "lab2_reduction");
+    const char *placement_spec = "none";
+    const char *stream_path = NULL, *make_path = NULL;
+    stream_io_t stream_io = STREAM_IO_READ;
+    long long stream_slice_elems = STREAM_SLICE, make_count = 50000000;
+    int verify = 0;
+    uint64_t seed = PRNG_DEFAULT_SEED;
+    for (int i = 1; i < argc; i++) {
+        int harness_arg = harness_parse_arg(&harness, argc, argv, &i);
+        if (harness_arg < 0) {
+            printf("Invalid value for %s\n", argv[i - 1]);
+            return 1;
+        } else if (harness_arg > 0) {
+            continue;
+        } else if (strcmp(argv[i], "--placement") == 0 && i + 1 < argc) {
+            placement_spec = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+            stream_path = argv[++i];
+        } else if (strcmp(argv[i], "--io") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "read") == 0) stream_io = STREAM_IO_READ;
+            else if (strcmp(argv[i], "mmap") == 0) stream_io = STREAM_IO_MMAP;
+            else {
+                printf("Invalid I/O mode '%s' (read or mmap)\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--slice") == 0 && i + 1 < argc) {
+            stream_slice_elems = strtoll(argv[++i], NULL, 0);
+            if (stream_slice_elems <= 0) {
+                printf("Slice must be positive\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            verify = 1;
+        } else if (strcmp(argv[i], "--make-stream") == 0 && i + 1 < argc) {
+            make_path = argv[++i];
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            make_count = strtoll(argv[++i], NULL, 0);
+        } else {
+            printf("Usage: %s [--placement none|compact|scatter|CPU-LIST] [--seed N] %s\n"
+                   "       %s --stream FILE|- [--io read|mmap] [--slice N] [--verify]\n"
+                   "       %s --make-stream FILE [--count N] [--seed N]\n",
+                   argv[0], harness_usage(), argv[0], argv[0]);
+            return 1;
+        }
+    }
+    
+    placement_t placement;
+    if (placement_init(&placement, placement_spec) != 0) {
+        printf("Invalid placement '%s'\n", placement_spec);
+        return 1;
+    }
+    
+    if (make_path != NULL) {
+        return make_stream_file(make_path, make_count, seed) == 0 ? 0 : 1;
+    }
+    if (stream_path != NULL) {
+        apply_placement(&placement);
+        return run_stream(stream_path, stream_io, stream_slice_elems, verify) == 0 ? 0 : 1;
+    }
+    if (harness_open(&harness) != 0) {
+        printf("Cannot write '%s' (use a .csv or .json file)\n", harness.output);
+        return 1;
+    }
+    
     printf("================================================================================\n");
     printf("               OPENMP REDUCTION PERFORMANCE COMPARISON\n");
     printf("================================================================================\n\n");
@@ -148,12 +1295,14 @@ int main() {
     // Test different array sizes
     long long sizes[] = {1000, 10000, 100000, 1000000, 10000000, 50000000};
     int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
-    const int num_trials = 3;
-    
     // Set number of threads
     omp_set_num_threads(8);
+    apply_placement(&placement);
     printf("Number of threads: %d\n", omp_get_max_threads());
-    printf("Number of trials per method: %d\n\n", num_trials);
+    printf("Placement: %s\n", placement_mode_name(placement.mode));
+    printf("Trials per method: %d after %d warmup (times are medians)\n", harness.trials,
+           harness.warmup);
+    printf("SIMD kernels: %s\n\n", select_sum_kernel()->name);
     
     for (int s = 0; s < num_sizes; s++) {
         long long size = sizes[s];
@@ -167,58 +1316,42 @@ int main() {
             continue;
         }
         
-        initialize_array(array, size);
+        initialize_array(array, size, seed);
         
         // Get reference sequential sum
-        double seq_start = omp_get_wtime();
-        double expected_sum = sequential_sum(array, size);
-        double seq_time = omp_get_wtime() - seq_start;
-        
-        printf("Sequential sum: %.2f (Time: %.6f seconds)\n", expected_sum, seq_time);
-        printf("--------------------------------------------------------------------------------\n");
-        printf("| Method               | Time (s)   | Speedup  | Result       | Error     |\n");
-        printf("--------------------------------------------------------------------------------\n");
-        
-        double times[5] = {0}; // reduction, critical, atomic, manual, lock
-        double sums[5];
-        
-        // Run multiple trials for each method
-        for (int trial = 0; trial < num_trials; trial++) {
-            double time;
-            
-            // Test each method
-            sums[0] = reduction_sum(array, size, &time);
-            times[0] += time;
-            
-            sums[1] = critical_sum(array, size, &time);
-            times[1] += time;
-            
-            sums[2] = atomic_sum(array, size, &time);
-            times[2] += time;
-            
-            sums[3] = manual_reduction_sum(array, size, &time);
-            times[3] += time;
-            
-            sums[4] = lock_sum(array, size, &time);
-            times[4] += time;
+        double seq_samples[HARNESS_MAX_TRIALS], naive_sum = 0.0;
+        harness_counters_t seq_counters = {0};
+        for (int trial = -harness.warmup; trial < harness.trials; trial++) {
+            double seq_start = harness_start(&harness, trial);
+            naive_sum = sequential_sum(array, size);
+            harness_stop(&harness, trial, seq_start, seq_samples, &seq_counters);
         }
+        harness_stats_t seq_stats;
+        harness_summarize(seq_samples, harness.trials, &seq_stats);
+        harness_record_t seq_record = {"sum", "Sequential", NULL, size, 1,
+                                       size * sizeof(double) * 1e-9, "GB/s", &seq_counters};
+        harness_emit(&harness, &seq_record, &seq_stats);
+        double seq_time = seq_stats.median;
+        double expected_sum = reference_sum(array, size);
         
-        // Calculate average times
-        for (int i = 0; i < 5; i++) {
-            times[i] /= num_trials;
-        }
+        printf("Sequential sum: %.6f (Time: %.6f seconds), compensated reference: %.6f\n",
+               naive_sum, seq_time, expected_sum);
+        printf("-----------------------------------------------------------------------------------------------\n");
+        printf("| Method               | Time (s)   | Speedup  | GB/s     | Result             | Error     |\n");
+        printf("-----------------------------------------------------------------------------------------------\n");
         
-        // Use reduction time as baseline for speedup calculation
-        double baseline_time = times[0];
+        harness_stats_t stats[NUM_SUM_METHODS];
+        double sums[NUM_SUM_METHODS];
+        time_sum_methods(&harness, "sum", array, size, &placement, stats, sums);
         
-        // Print results for each method
-        print_results("Reduction", times[0], baseline_time, sums[0], expected_sum);
-        print_results("Critical Section", times[1], baseline_time, sums[1], expected_sum);
-        print_results("Atomic", times[2], baseline_time, sums[2], expected_sum);
-        print_results("Manual", times[3], baseline_time, sums[3], expected_sum);
-        print_results("Lock", times[4], baseline_time, sums[4], expected_sum);
+        // Use reduction time as baseline for speedup calculation
+        double baseline_time = stats[SUM_REDUCTION].median;
+        for (int m = 0; m < NUM_SUM_METHODS; m++) {
+            print_results(sum_method_names[m], stats[m].median, baseline_time, sums[m],
+                          expected_sum, size);
+        }
         
-        printf("--------------------------------------------------------------------------------\n\n");
+        printf("-----------------------------------------------------------------------------------------------\n\n");
         
         free(array);
     }
@@ -229,33 +1362,65 @@ int main() {
     
     long long test_size = 10000000;
     double *test_array = (double*)malloc(test_size * sizeof(double));
-    initialize_array(test_array, test_size);
     
-    int thread_counts[] = {1, 2, 4, 8, 16};
-    int num_threads = sizeof(thread_counts) / sizeof(thread_counts[0]);
+    // Powers of two up to the machine (at least 16), then the full core count
+    int num_procs = omp_get_num_procs();
+    int thread_counts[32];
+    int num_threads = 0;
+    for (int t = 1; t <= (num_procs > 16 ? num_procs : 16) && num_threads < 31; t *= 2) {
+        thread_counts[num_threads++] = t;
+    }
+    if (thread_counts[num_threads - 1] != num_procs && num_procs > 16) {
+        thread_counts[num_threads++] = num_procs;
+    }
+    
+    // First touch with the widest team so pages spread over every node used
+    omp_set_num_threads(thread_counts[num_threads - 1]);
+    apply_placement(&placement);
+    initialize_array(test_array, test_size, seed);
     
-    printf("Threads | Reduction  | Critical   | Atomic     | Manual     | Speedup\n");
-    printf("--------|------------|------------|------------|------------|--------\n");
+    printf("Threads | Reduction  | Critical   | Atomic     | Manual     | Lock       | Tree       | SIMD       | Compensated | Speedup\n");
+    printf("--------|------------|------------|------------|------------|------------|------------|------------|-------------|--------\n");
+    
+    double first_compensated = 0.0, single_thread_time = 0.0;
+    int reproducible = 1;
     
     for (int t = 0; t < num_threads; t++) {
         omp_set_num_threads(thread_counts[t]);
+        apply_placement(&placement);
         
-        double red_time, crit_time, atomic_time, manual_time;
-        
-        reduction_sum(test_array, test_size, &red_time);
-        critical_sum(test_array, test_size, &crit_time);
-        atomic_sum(test_array, test_size, &atomic_time);
-        manual_reduction_sum(test_array, test_size, &manual_time);
+        harness_stats_t stats[NUM_SUM_METHODS];
+        double sums[NUM_SUM_METHODS];
+        time_sum_methods(&harness, "sum_scaling", test_array, test_size, &placement, stats, sums);
+        double red_time = stats[SUM_REDUCTION].median;
+        double comp = sums[SUM_COMPENSATED];
+        if (t == 0) first_compensated = comp;
+        if (memcmp(&comp, &first_compensated, sizeof(comp)) != 0) reproducible = 0;
         
-        double single_thread_time = (t == 0) ? red_time : 0;
-        double speedup = (t == 0) ? 1.0 : single_thread_time / red_time;
+        // Speedup of the reduction clause over its own 1-thread time
+        if (t == 0) single_thread_time = red_time;
+        double speedup = single_thread_time / red_time;
         
-        printf("   %2d   | %8.6f  | %8.6f  | %8.6f  | %8.6f  | %6.2fx\n",
-               thread_counts[t], red_time, crit_time, atomic_time, manual_time, speedup);
+        printf("  %4d  | %8.6f  | %8.6f  | %8.6f  | %8.6f  | %8.6f  | %8.6f  | %8.6f  | %9.6f   | %6.2fx\n",
+               thread_counts[t], red_time, stats[SUM_CRITICAL].median, stats[SUM_ATOMIC].median,
+               stats[SUM_MANUAL].median, stats[SUM_LOCK].median, stats[SUM_TREE].median,
+               stats[SUM_SIMD].median, stats[SUM_COMPENSATED].median, speedup);
     }
+    printf("Compensated result bitwise identical across thread counts: %s\n",
+           reproducible ? "yes" : "NO");
     
     free(test_array);
     
+    if (placement.mode != PLACEMENT_NONE) {
+        omp_set_num_threads(8);
+        print_numa_analysis(&placement, seed);
+    }
+    
+    omp_set_num_threads(8);
+    apply_placement(&placement);
+    print_library_analysis(&harness, sizes, num_sizes, seed);
+    print_scan_analysis(&harness, sizes, num_sizes, seed);
+    
     printf("\nCONCLUSIONS:\n");
     printf("============\n");
     printf("1. REDUCTION is fastest - optimized private copies + efficient merging\n");
@@ -263,6 +1428,11 @@ int main() {
     printf("3. ATOMIC is slowest for large arrays due to high contention\n");
     printf("4. MANUAL reduction offers flexibility but requires more code\n");
     printf("5. Performance differences become significant with larger arrays\n");
+    printf("6. SIMD multi-accumulator kernels break the add dependency chain and approach memory bandwidth\n");
+    printf("7. COMPENSATED summation gives the same bits for every thread count at near-SIMD speed\n");
+    printf("8. TREE combine of padded partials needs no lock and only log2(threads) barrier rounds\n");
+    printf("9. SCAN look-back makes one pass over memory where the three-phase scan makes two\n");
     
+    harness_close(&harness);
     return 0;
 }
\ No newline at end of file
@@ -3,6 +3,13 @@
 #include <math.h>
 #include <omp.h>
 #include <time.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "prng.h"
+#include "scan.h"
+#include "harness.h"
 
 // Check if a number is prime
 int is_prime(int n) {
@@ -17,9 +24,277 @@ int is_prime(int n) {
     return 1;
 }
 
+// ---------------------------------------------------------------------------
+// Segmented sieve of Eratosthenes
+//
+// Odd numbers only, one bit each (set = composite): a segment of
+// SIEVE_SEGMENT_BYTES fits in L1 and covers SIEVE_SEGMENT_SPAN integers.
+// Bit j of the segment starting at seg_lo stands for seg_lo + 2j + 1. Each
+// thread takes a contiguous run of segments and keeps, for every base
+// prime, the bit index of its next odd multiple, so the starting offsets
+// are divided out once per thread rather than once per segment. Memory is
+// the base primes plus one segment per thread, whatever the range.
+// ---------------------------------------------------------------------------
+
+#define SIEVE_SEGMENT_BYTES (32 * 1024)
+#define SIEVE_SEGMENT_WORDS (SIEVE_SEGMENT_BYTES / 8)
+#define SIEVE_SEGMENT_BITS (SIEVE_SEGMENT_BYTES * 8)
+#define SIEVE_SEGMENT_SPAN (2ULL * SIEVE_SEGMENT_BITS)
+
+// Multiples of 3, 5, 7, 11 and 13 repeat every 15015 odd numbers: they are
+// copied into each segment from a precomputed pattern instead of marked
+#define SIEVE_PRESIEVE_PERIOD 15015
+#define SIEVE_PRESIEVE_LAST 13
+#define SIEVE_PATTERN_WORDS ((SIEVE_PRESIEVE_PERIOD + SIEVE_SEGMENT_BITS) / 64 + 2)
+
+typedef struct {
+    uint32_t *primes;   // odd primes p with p * p < limit
+    long long count;
+    long long first;    // first index above SIEVE_PRESIEVE_LAST
+    const uint64_t *pattern;  // pre-sieved bits, SIEVE_PATTERN_WORDS long
+} base_primes_t;
+
+// Built on first use and shared by every sieve after that
+static const uint64_t *sieve_pattern(void) {
+    static uint64_t pattern[SIEVE_PATTERN_WORDS];
+    static int ready = 0;
+    #pragma omp critical(sieve_pattern)
+    {
+        if (!ready) {
+            for (uint64_t j = 0; j < SIEVE_PATTERN_WORDS * 64ULL; j++) {
+                uint64_t n = 2 * j + 1;
+                if (n % 3 == 0 || n % 5 == 0 || n % 7 == 0 || n % 11 == 0 || n % 13 == 0) {
+                    pattern[j >> 6] |= 1ULL << (j & 63);
+                }
+            }
+            ready = 1;
+        }
+    }
+    return pattern;
+}
+
+static uint64_t isqrt64(uint64_t n) {
+    uint64_t r = (uint64_t)sqrt((double)n);
+    while (r > 0 && r * r > n) r--;
+    while ((r + 1) * (r + 1) <= n) r++;
+    return r;
+}
+
+// Plain odd-only sieve up to sqrt(limit); returns -1 if out of memory
+static int base_primes_init(base_primes_t *base, uint64_t limit) {
+    uint64_t root = limit > 0 ? isqrt64(limit - 1) : 0;
+    uint64_t half = root / 2 + 1; // index i stands for 2i + 1
+    char *composite = (char *)calloc(half, 1);
+
+    base->count = 0;
+    base->primes = (uint32_t *)malloc((half > 0 ? half : 1) * sizeof(uint32_t));
+    if (composite == NULL || base->primes == NULL) {
+        free(composite);
+        free(base->primes);
+        return -1;
+    }
+    for (uint64_t i = 1; i < half; i++) {
+        if (composite[i]) continue;
+        uint64_t p = 2 * i + 1;
+        base->primes[base->count++] = (uint32_t)p;
+        for (uint64_t j = p * p / 2; j < half; j += p) composite[j] = 1;
+    }
+    free(composite);
+
+    base->first = 0;
+    while (base->first < base->count && base->primes[base->first] <= SIEVE_PRESIEVE_LAST) {
+        base->first++;
+    }
+    base->pattern = sieve_pattern();
+    return 0;
+}
+
+static void base_primes_free(base_primes_t *base) {
+    free(base->primes);
+}
+
+// Copy the pattern, shifted to the segment's phase, over the whole segment
+static void sieve_presieve(uint64_t *bits, const uint64_t *pattern, uint64_t seg_lo) {
+    uint64_t offset = (seg_lo / 2) % SIEVE_PRESIEVE_PERIOD;
+    const uint64_t *src = pattern + (offset >> 6);
+    unsigned shift = offset & 63;
+    if (shift == 0) {
+        memcpy(bits, src, SIEVE_SEGMENT_BYTES);
+        return;
+    }
+    for (int w = 0; w < SIEVE_SEGMENT_WORDS; w++) {
+        bits[w] = (src[w] >> shift) | (src[w + 1] << (64 - shift));
+    }
+}
+
+// Called for every segment, in increasing order within a thread
+typedef void (*sieve_visit_t)(void *ctx, uint64_t segment, uint64_t seg_lo, const uint64_t *bits);
+
+// First segment that sieve_range(lo, ...) visits, and how many there are
+static uint64_t sieve_first(uint64_t lo) {
+    return lo - lo % SIEVE_SEGMENT_SPAN;
+}
+
+static uint64_t sieve_segments(uint64_t lo, uint64_t hi) {
+    return hi > lo ? (hi - sieve_first(lo) + SIEVE_SEGMENT_SPAN - 1) / SIEVE_SEGMENT_SPAN : 0;
+}
+
+// Bit index, in the segment at seg_lo, of the first odd multiple of p at
+// or above max(p * p, from); from >= seg_lo
+static uint64_t sieve_offset(uint64_t p, uint64_t seg_lo, uint64_t from) {
+    uint64_t start = p * p;
+    if (start < from) {
+        start = (from + p - 1) / p * p;
+        if (start % 2 == 0) start += p;
+    }
+    return (start - seg_lo - 1) / 2;
+}
+
+// Sieve segments [s_begin, s_end) of the range [lo, hi) on the calling
+// thread and hand each one to visit; base must cover hi. -1 if out of memory.
+static int sieve_run(const base_primes_t *base, uint64_t lo, uint64_t hi, uint64_t s_begin,
+                     uint64_t s_end, sieve_visit_t visit, void *ctx) {
+    uint64_t first = sieve_first(lo);
+
+    if (s_begin >= s_end) return 0;
+
+    // base may cover more than hi (a table's base primes): stop at sqrt(hi)
+    long long count = 0, top = base->count;
+    while (count < top) {
+        long long mid = count + (top - count) / 2;
+        if ((uint64_t)base->primes[mid] * base->primes[mid] < hi) count = mid + 1;
+        else top = mid;
+    }
+    uint64_t *bits = (uint64_t *)aligned_alloc(64, SIEVE_SEGMENT_BYTES);
+    uint64_t *next = (uint64_t *)malloc((count > 0 ? count : 1) * sizeof(uint64_t));
+    if (bits == NULL || next == NULL) {
+        free(bits);
+        free(next);
+        return -1;
+    }
+
+    uint64_t start_lo = first + s_begin * SIEVE_SEGMENT_SPAN;
+    for (long long k = 0; k < count; k++) {
+        next[k] = sieve_offset(base->primes[k], start_lo, start_lo > lo ? start_lo : lo);
+    }
+    for (uint64_t s = s_begin; s < s_end; s++) {
+        uint64_t seg_lo = first + s * SIEVE_SEGMENT_SPAN;
+        uint64_t nbits = hi - seg_lo < SIEVE_SEGMENT_SPAN ? (hi - seg_lo) / 2 : SIEVE_SEGMENT_BITS;
+        sieve_presieve(bits, base->pattern, seg_lo);
+        for (long long k = base->first; k < count; k++) {
+            uint64_t p = base->primes[k], j = next[k];
+            for (; j < nbits; j += p) bits[j >> 6] |= 1ULL << (j & 63);
+            next[k] = j - SIEVE_SEGMENT_BITS; // only a range's last segment is short
+        }
+        if (seg_lo == 0) {
+            bits[0] |= 1;       // 1 is not prime
+            bits[0] &= ~0x6eULL; // 3, 5, 7, 11, 13 are, though the pattern marks them
+        }
+        visit(ctx, s, seg_lo, bits);
+    }
+    free(bits);
+    free(next);
+    return 0;
+}
+
+// Sieve every segment overlapping [lo, hi) in parallel and hand each one to
+// visit. Segment 0's bit for 1 is set; 2 is even and never represented.
+// Only the bits inside [lo, hi) are sieved, so a short query pays for its
+// own range rather than whole segments; the rest must be masked off with
+// sieve_bit_range.
+static int sieve_range(uint64_t lo, uint64_t hi, sieve_visit_t visit, void *ctx) {
+    base_primes_t base;
+    uint64_t num_segments = sieve_segments(lo, hi);
+    int failed = 0;
+
+    if (num_segments == 0) return 0;
+    if (base_primes_init(&base, hi) != 0) return -1;
+
+    #pragma omp parallel
+    {
+        int num_threads = omp_get_num_threads();
+        int thread_id = omp_get_thread_num();
+        uint64_t s_begin = num_segments * thread_id / num_threads;
+        uint64_t s_end = num_segments * (thread_id + 1) / num_threads;
+
+        if (sieve_run(&base, lo, hi, s_begin, s_end, visit, ctx) != 0) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+    }
+    base_primes_free(&base);
+    return failed ? -1 : 0;
+}
+
+// Bit range of the segment at seg_lo that falls inside [lo, hi)
+static void sieve_bit_range(uint64_t seg_lo, uint64_t lo, uint64_t hi, uint64_t *jb, uint64_t *je) {
+    *jb = lo > seg_lo ? (lo - seg_lo) / 2 : 0;
+    *je = hi > seg_lo ? (hi - seg_lo) / 2 : 0;
+    if (*jb > SIEVE_SEGMENT_BITS) *jb = SIEVE_SEGMENT_BITS;
+    if (*je > SIEVE_SEGMENT_BITS) *je = SIEVE_SEGMENT_BITS;
+}
+
+// Odd primes (clear bits) of a segment that lie in [lo, hi)
+static long long sieve_segment_count(const uint64_t *bits, uint64_t seg_lo, uint64_t lo, uint64_t hi) {
+    uint64_t jb, je;
+    long long count = 0;
+    sieve_bit_range(seg_lo, lo, hi, &jb, &je);
+    for (uint64_t j = jb; j < je;) {
+        uint64_t word = ~bits[j >> 6] >> (j & 63);
+        uint64_t take = 64 - (j & 63);
+        if (take > je - j) take = je - j;
+        if (take < 64) word &= (1ULL << take) - 1;
+        count += __builtin_popcountll(word);
+        j += take;
+    }
+    return count;
+}
+
+typedef struct {
+    uint64_t lo, hi;
+    long long *counts;  // per segment
+} sieve_count_ctx_t;
+
+static void sieve_count_visit(void *ctx, uint64_t segment, uint64_t seg_lo, const uint64_t *bits) {
+    sieve_count_ctx_t *c = (sieve_count_ctx_t *)ctx;
+    c->counts[segment] = sieve_segment_count(bits, seg_lo, c->lo, c->hi);
+}
+
+// Number of primes in [lo, hi); -1 if out of memory
+long long sieve_count(uint64_t lo, uint64_t hi) {
+    uint64_t num_segments = sieve_segments(lo, hi);
+    sieve_count_ctx_t ctx = {lo, hi, (long long *)calloc(num_segments + 1, sizeof(long long))};
+    long long total = lo <= 2 && hi > 2 ? 1 : 0;
+
+    if (ctx.counts == NULL || sieve_range(lo, hi, sieve_count_visit, &ctx) != 0) {
+        free(ctx.counts);
+        return -1;
+    }
+    for (uint64_t s = 0; s < num_segments; s++) total += ctx.counts[s];
+    free(ctx.counts);
+    return total;
+}
+
+// sieve_count on the calling thread with base primes that cover hi, for
+// short ranges where a parallel region and a fresh base sieve cost more
+// than the range itself
+static long long sieve_count_serial(const base_primes_t *base, uint64_t lo, uint64_t hi) {
+    uint64_t num_segments = sieve_segments(lo, hi);
+    sieve_count_ctx_t ctx = {lo, hi, (long long *)calloc(num_segments + 1, sizeof(long long))};
+    long long total = lo <= 2 && hi > 2 ? 1 : 0;
+
+    if (ctx.counts == NULL || sieve_run(base, lo, hi, 0, num_segments, sieve_count_visit, &ctx) != 0) {
+        free(ctx.counts);
+        return -1;
+    }
+    for (uint64_t s = 0; s < num_segments; s++) total += ctx.counts[s];
+    free(ctx.counts);
+    return total;
+}
+
 // Find primes sequentially
 void find_primes_sequential(int target_count, int *primes, double *elapsed_time) {
-    clock_t start = clock();
+    double start = harness_now();
     
     int count = 0;
     int num = 2;
@@ -31,44 +306,735 @@ void find_primes_sequential(int target_count, int *primes, double *elapsed_time)
         num++;
     }
     
-    clock_t end = clock();
-    *elapsed_time = ((double)(end - start)) / CLOCKS_PER_SEC;
+    *elapsed_time = harness_now() - start;
+}
+
+// Write the odd primes of a segment that lie in [lo, hi) to out, at most
+// max of them; returns how many were written
+#define DEFINE_SIEVE_EMIT(NAME, T)                                                        \
+static long long NAME(const uint64_t *bits, uint64_t seg_lo, uint64_t lo, uint64_t hi,   \
+                      T *out, long long max) {                                           \
+    uint64_t jb, je;                                                                     \
+    long long count = 0;                                                                 \
+    sieve_bit_range(seg_lo, lo, hi, &jb, &je);                                           \
+    for (uint64_t w = jb >> 6; w * 64 < je && count < max; w++) {                        \
+        uint64_t clear = ~bits[w];                                                       \
+        if (w * 64 < jb) clear &= ~0ULL << (jb & 63);                                    \
+        while (clear != 0 && count < max) {                                              \
+            uint64_t j = w * 64 + __builtin_ctzll(clear);                                \
+            if (j >= je) break;                                                          \
+            out[count++] = (T)(seg_lo + 2 * j + 1);                                      \
+            clear &= clear - 1;                                                          \
+        }                                                                                \
+    }                                                                                    \
+    return count;                                                                        \
 }
 
-// Estimate upper bound for nth prime number
-int estimate_nth_prime(int n) {
-    if (n < 6) return 15;
-    double log_n = log(n);
-    return (int)(n * (log_n + log(log_n) + 2));
+DEFINE_SIEVE_EMIT(sieve_segment_emit, int)
+DEFINE_SIEVE_EMIT(sieve_segment_emit_u64, uint64_t)
+
+// Segments land in one bit-packed odd-only bitmap (1 bit per odd number
+// instead of an int per integer), and each segment's prime count is kept
+// for the compaction
+typedef struct {
+    uint64_t *bitmap;
+    int64_t *counts;    // per segment, odd primes in [lo, hi)
+    uint64_t lo, hi;
+} sieve_store_ctx_t;
+
+static void sieve_store_visit(void *ctx, uint64_t segment, uint64_t seg_lo, const uint64_t *bits) {
+    sieve_store_ctx_t *c = (sieve_store_ctx_t *)ctx;
+    memcpy(c->bitmap + segment * SIEVE_SEGMENT_WORDS, bits, SIEVE_SEGMENT_BYTES);
+    c->counts[segment] = sieve_segment_count(bits, seg_lo, c->lo, c->hi);
 }
 
-// Find primes in parallel using OpenMP
-void find_primes_parallel(int target_count, int *primes, double *elapsed_time) {
-    double start = omp_get_wtime();
+#define SIEVE_BATCH_SEGMENTS 4 // segments per thread in a full batch
+
+// Find primes in parallel using OpenMP: sieve successive batches of
+// segments until target_count primes are out, so no bound is estimated and
+// nothing past the last batch is sieved. A batch starts at one segment
+// and doubles up to SIEVE_BATCH_SEGMENTS per thread; memory is that batch
+// plus the base primes. Within a batch, an exclusive scan of the
+// per-segment counts gives every segment its first slot in primes[], so
+// each thread writes its segments' primes straight to their final
+// positions. Returns 0, or -1 if memory runs out before target_count.
+int find_primes_parallel(int target_count, int *primes, double *elapsed_time) {
+    double start = harness_now();
+    
+    uint64_t max_segments = (uint64_t)omp_get_max_threads() * SIEVE_BATCH_SEGMENTS;
+    sieve_store_ctx_t ctx = {(uint64_t *)malloc(max_segments * SIEVE_SEGMENT_BYTES),
+                             (int64_t *)malloc(max_segments * sizeof(int64_t)), 0, 0};
+    int64_t *offsets = (int64_t *)malloc(max_segments * sizeof(int64_t));
     
-    int upper_bound = estimate_nth_prime(target_count);
-    int *is_prime_array = (int*)calloc(upper_bound + 1, sizeof(int));
+    // 2 is even and not in the bitmap; it takes slot 0
+    long long count = 0;
+    if (target_count > 0) primes[count++] = 2;
     
-    // Mark primes in parallel
-    #pragma omp parallel for schedule(dynamic)
-    for (int i = 2; i <= upper_bound; i++) {
-        if (is_prime(i)) {
-            is_prime_array[i] = 1;
+    int status = ctx.bitmap != NULL && ctx.counts != NULL && offsets != NULL ? 0 : -1;
+    uint64_t segments = 1;
+    while (status == 0 && count < target_count) {
+        ctx.hi = ctx.lo + segments * SIEVE_SEGMENT_SPAN;
+        if (sieve_range(ctx.lo, ctx.hi, sieve_store_visit, &ctx) != 0) {
+            status = -1;
+            break;
         }
+        scan_i64(ctx.counts, offsets, segments, SCAN_EXCLUSIVE);
+        
+        #pragma omp parallel for schedule(static)
+        for (uint64_t seg = 0; seg < segments; seg++) {
+            long long first = count + offsets[seg];
+            if (first >= target_count) continue;
+            sieve_segment_emit(ctx.bitmap + seg * SIEVE_SEGMENT_WORDS, ctx.lo + seg * SIEVE_SEGMENT_SPAN,
+                               ctx.lo, ctx.hi, primes + first, target_count - first);
+        }
+        count += offsets[segments - 1] + ctx.counts[segments - 1];
+        ctx.lo = ctx.hi;
+        segments = segments * 2 < max_segments ? segments * 2 : max_segments;
     }
     
-    // Collect primes sequentially (to maintain order)
-    int count = 0;
-    for (int i = 2; i <= upper_bound && count < target_count; i++) {
-        if (is_prime_array[i]) {
-            primes[count++] = i;
+    free(ctx.bitmap);
+    free(ctx.counts);
+    free(offsets);
+    
+    double end = harness_now();
+    *elapsed_time = end - start;
+    return status;
+}
+
+// Count primes up to powers of ten with the segmented sieve
+void print_sieve_analysis(harness_t *h, int max_exponent) {
+    // pi(10^k), k = 1 .. 12
+    static const long long known[] = {4LL, 25LL, 168LL, 1229LL, 9592LL, 78498LL, 664579LL,
+                                      5761455LL, 50847534LL, 455052511LL, 4118054813LL,
+                                      37607912018LL};
+    
+    printf("\n============================================================\n");
+    printf("Segmented sieve: pi(x) (%d KB segments, %d threads)\n",
+           SIEVE_SEGMENT_BYTES / 1024, omp_get_max_threads());
+    printf("============================================================\n");
+    printf("%16s %14s %12s %14s %6s\n", "x", "pi(x)", "Time (s)", "Numbers/s", "Check");
+    
+    uint64_t x = 1;
+    for (int k = 1; k <= max_exponent && k <= 12; k++) {
+        x *= 10;
+        double samples[HARNESS_MAX_TRIALS];
+        harness_counters_t counters = {0};
+        long long count = 0;
+        for (int trial = -h->warmup; trial < h->trials; trial++) {
+            double start = harness_start(h, trial);
+            count = sieve_count(0, x + 1);
+            harness_stop(h, trial, start, samples, &counters);
         }
+        harness_stats_t stats;
+        harness_summarize(samples, h->trials, &stats);
+        harness_record_t record = {"pi", "segmented sieve", NULL, (long long)x,
+                                   omp_get_max_threads(), (double)x, "numbers/s", &counters};
+        harness_emit(h, &record, &stats);
+        double elapsed = stats.median;
+        printf("%16llu %14lld %12.6f %14.3e %6s\n", (unsigned long long)x, count, elapsed,
+               elapsed > 0.0 ? x / elapsed : 0.0, count == known[k - 1] ? "ok" : "FAIL");
     }
+}
+
+// ---------------------------------------------------------------------------
+// Deterministic Miller-Rabin for 64-bit candidates
+//
+// For sparse candidates where a sieve makes no sense. Trial division by
+// the primes below 100 settles most composites (and every n < 100^2);
+// the rest go through strong-probable-prime tests to the seven bases of
+// Jim Sinclair's set, which have no common pseudoprime below 2^64. The
+// modular arithmetic stays in Montgomery form, so every multiply is two
+// 64x64->128 products and no division.
+// ---------------------------------------------------------------------------
+
+static const uint32_t small_primes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43,
+                                        47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97};
+#define NUM_SMALL_PRIMES (sizeof(small_primes) / sizeof(small_primes[0]))
+#define SMALL_PRIME_LIMIT 101ULL // next prime: below its square, passing trial division means prime
+
+static const uint64_t mr_bases[] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+
+typedef unsigned __int128 u128;
+
+typedef struct {
+    uint64_t n;
+    uint64_t inv;   // n^-1 mod 2^64
+    uint64_t one;   // R mod n, R = 2^64
+    uint64_t r2;    // R^2 mod n
+} montgomery_t;
+
+static inline void montgomery_init(montgomery_t *m, uint64_t n) {
+    uint64_t inv = n; // correct to 3 bits for odd n; each step doubles that
+    for (int i = 0; i < 5; i++) inv *= 2 - n * inv;
+    m->n = n;
+    m->inv = inv;
+    m->one = (uint64_t)(((u128)1 << 64) % n);
+    m->r2 = (uint64_t)((u128)m->one * m->one % n);
+}
+
+// a * b * R^-1 mod n for a, b < n
+static inline uint64_t montgomery_mul(const montgomery_t *m, uint64_t a, uint64_t b) {
+    u128 t = (u128)a * b;
+    uint64_t q = (uint64_t)t * m->inv;
+    uint64_t hi = (uint64_t)(t >> 64), qn = (uint64_t)(((u128)q * m->n) >> 64);
+    return hi >= qn ? hi - qn : hi - qn + m->n;
+}
+
+static inline uint64_t montgomery_to(const montgomery_t *m, uint64_t a) {
+    return montgomery_mul(m, a % m->n, m->r2);
+}
+
+// Strong probable prime to base a; n odd, n - 1 = d * 2^s
+static int miller_rabin_round(const montgomery_t *m, uint64_t a, uint64_t d, int s) {
+    uint64_t minus_one = m->n - m->one; // -1 in Montgomery form
+    uint64_t base = montgomery_to(m, a);
+    if (base == 0) return 1; // a is a multiple of n: says nothing
     
-    free(is_prime_array);
+    uint64_t x = m->one;
+    for (; d > 0; d >>= 1) {
+        if (d & 1) x = montgomery_mul(m, x, base);
+        base = montgomery_mul(m, base, base);
+    }
+    if (x == m->one || x == minus_one) return 1;
+    for (int r = 1; r < s; r++) {
+        x = montgomery_mul(m, x, x);
+        if (x == minus_one) return 1;
+    }
+    return 0;
+}
+
+// Deterministic for every 64-bit n
+int is_prime_u64(uint64_t n) {
+    if (n < 2) return 0;
+    for (size_t i = 0; i < NUM_SMALL_PRIMES; i++) {
+        if (n % small_primes[i] == 0) return n == small_primes[i];
+    }
+    if (n < SMALL_PRIME_LIMIT * SMALL_PRIME_LIMIT) return 1;
     
-    double end = omp_get_wtime();
-    *elapsed_time = end - start;
+    montgomery_t m;
+    montgomery_init(&m, n);
+    uint64_t d = n - 1;
+    int s = __builtin_ctzll(d);
+    d >>= s;
+    for (size_t i = 0; i < sizeof(mr_bases) / sizeof(mr_bases[0]); i++) {
+        if (!miller_rabin_round(&m, mr_bases[i], d, s)) return 0;
+    }
+    return 1;
+}
+
+// results[i] = is_prime_u64(candidates[i]). Composites usually leave at
+// the trial division and primes run all seven rounds, so candidates are
+// dealt out dynamically in small chunks. Returns the number of primes.
+long long is_prime_batch(const uint64_t *candidates, unsigned char *results, long long count) {
+    long long primes = 0;
+    #pragma omp parallel for schedule(dynamic, 256) reduction(+:primes)
+    for (long long i = 0; i < count; i++) {
+        results[i] = (unsigned char)is_prime_u64(candidates[i]);
+        primes += results[i];
+    }
+    return primes;
+}
+
+// Agreement with is_prime, then random 64-bit throughput, cross-checked
+// against the sieve on a range both can handle
+void print_primality_analysis(harness_t *h) {
+    const long long exhaustive = 2000000, sampled = 200000, batch = 1000000;
+    const uint64_t window_lo = 100000000000000ULL, window = 2000000;
+    long long mismatches = 0;
+    
+    printf("\n============================================================\n");
+    printf("Miller-Rabin (Montgomery, %zu bases, %d threads)\n",
+           sizeof(mr_bases) / sizeof(mr_bases[0]), omp_get_max_threads());
+    printf("============================================================\n");
+    
+    #pragma omp parallel for schedule(dynamic, 4096) reduction(+:mismatches)
+    for (long long n = 0; n < exhaustive; n++) {
+        mismatches += is_prime_u64(n) != is_prime((int)n);
+    }
+    #pragma omp parallel for schedule(dynamic, 256) reduction(+:mismatches)
+    for (long long i = 0; i < sampled; i++) {
+        uint32_t r[4];
+        philox4x32(i, 0, PRNG_DEFAULT_SEED, r);
+        int n = (int)(r[0] & 0x7fffffff);
+        mismatches += is_prime_u64(n) != is_prime(n);
+    }
+    printf("Agreement with is_prime on [0, %lld) and %lld random ints: %s\n", exhaustive, sampled,
+           mismatches == 0 ? "ok" : "FAIL");
+    
+    uint64_t *candidates = (uint64_t *)malloc((batch > (long long)window ? batch : window) * sizeof(uint64_t));
+    unsigned char *results = (unsigned char *)malloc(batch > (long long)window ? batch : window);
+    if (candidates == NULL || results == NULL) {
+        printf("Memory allocation failed\n");
+        free(candidates);
+        free(results);
+        return;
+    }
+    
+    for (uint64_t i = 0; i < window; i++) candidates[i] = window_lo + i;
+    long long tested = is_prime_batch(candidates, results, window);
+    long long sieved = sieve_count(window_lo, window_lo + window);
+    printf("Primes in [10^14, 10^14 + %llu): batch %lld, sieve %lld: %s\n",
+           (unsigned long long)window, tested, sieved, tested == sieved ? "ok" : "FAIL");
+    
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < batch; i++) {
+        uint32_t r[4];
+        philox4x32(i, 1, PRNG_DEFAULT_SEED, r);
+        candidates[i] = ((uint64_t)r[0] << 32 | r[1]) | 1 | 1ULL << 63;
+    }
+    double samples[HARNESS_MAX_TRIALS];
+    harness_counters_t counters = {0};
+    long long found = 0;
+    for (int trial = -h->warmup; trial < h->trials; trial++) {
+        double start = harness_start(h, trial);
+        found = is_prime_batch(candidates, results, batch);
+        harness_stop(h, trial, start, samples, &counters);
+    }
+    harness_stats_t stats;
+    harness_summarize(samples, h->trials, &stats);
+    harness_record_t record = {"miller_rabin", "random odd 64-bit", NULL, batch,
+                               omp_get_max_threads(), (double)batch, "candidates/s", &counters};
+    harness_emit(h, &record, &stats);
+    double elapsed = stats.median;
+    printf("Random odd 64-bit candidates: %lld, primes: %lld (expected ~%.0f)\n", batch, found,
+           batch * 2.0 / (63.5 * log(2.0))); // odd n in [2^63, 2^64)
+    printf("Batch time: %.6f s, %.3e candidates/s\n", elapsed, batch / elapsed);
+    
+    free(candidates);
+    free(results);
+}
+
+// ---------------------------------------------------------------------------
+// Prime queries served from a checkpoint table
+//
+// pi[i] is the number of primes below i * 2^shift. The step is a whole
+// number of sieve segments, so a query sieves at most the segment between
+// x and its nearest checkpoint. The table is built once by a parallel
+// sieve and persisted in PRIME_TABLE_FILE; later runs load it.
+// ---------------------------------------------------------------------------
+
+#define PRIME_TABLE_FILE "lab3_primes.tbl"
+#define PRIME_TABLE_MAGIC "PPLPI001"
+#define PRIME_TABLE_SHIFT 19 // one checkpoint per sieve segment
+#define PRIME_TABLE_MISSING -1
+#define PRIME_TABLE_UNUSABLE -2
+
+typedef struct {
+    char magic[8];
+    uint32_t shift;
+    uint32_t reserved;
+    uint64_t limit;     // checkpoints cover [0, limit]
+    uint64_t entries;
+} prime_table_header_t;
+
+typedef struct {
+    uint32_t shift;
+    uint64_t limit;
+    uint64_t entries;
+    uint64_t *pi;       // pi[i] = number of primes below i << shift
+    base_primes_t base; // sieving primes below base_limit, kept for queries
+    uint64_t base_limit;
+} prime_table_t;
+
+// Base primes for every residual inside the table, so a query sieves its
+// few segments serially instead of re-sieving them and forking a team
+static int prime_table_init_base(prime_table_t *t) {
+    t->base_limit = t->limit + (1ULL << t->shift);
+    if (base_primes_init(&t->base, t->base_limit) != 0) {
+        t->base.primes = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Sieve [lo, hi) with the table's base primes when they cover it
+static int prime_table_sieve(const prime_table_t *t, uint64_t lo, uint64_t hi, sieve_visit_t visit,
+                             void *ctx) {
+    if (hi > t->base_limit) return sieve_range(lo, hi, visit, ctx);
+    return sieve_run(&t->base, lo, hi, 0, sieve_segments(lo, hi), visit, ctx);
+}
+
+static long long prime_table_count(const prime_table_t *t, uint64_t lo, uint64_t hi) {
+    return hi > t->base_limit ? sieve_count(lo, hi) : sieve_count_serial(&t->base, lo, hi);
+}
+
+// Sieve [0, limit) once; returns -1 if out of memory
+int prime_table_build(prime_table_t *t, uint64_t limit, uint32_t shift) {
+    uint64_t step = 1ULL << shift;
+    uint64_t per_step = step / SIEVE_SEGMENT_SPAN;
+    
+    t->shift = shift;
+    t->limit = (limit + step - 1) / step * step;
+    t->entries = t->limit / step + 1;
+    t->base.primes = NULL;
+    t->pi = (uint64_t *)malloc(t->entries * sizeof(uint64_t));
+    
+    uint64_t num_segments = sieve_segments(0, t->limit);
+    sieve_count_ctx_t ctx = {0, t->limit, (long long *)calloc(num_segments + 1, sizeof(long long))};
+    if (t->pi == NULL || ctx.counts == NULL || sieve_range(0, t->limit, sieve_count_visit, &ctx) != 0) {
+        free(t->pi);
+        free(ctx.counts);
+        t->pi = NULL;
+        return -1;
+    }
+    
+    t->pi[0] = 0;
+    for (uint64_t i = 1; i < t->entries; i++) {
+        uint64_t count = i == 1 ? 1 : 0; // 2 is not in the bitmap
+        for (uint64_t s = (i - 1) * per_step; s < i * per_step; s++) count += ctx.counts[s];
+        t->pi[i] = t->pi[i - 1] + count;
+    }
+    free(ctx.counts);
+    if (prime_table_init_base(t) != 0) {
+        free(t->pi);
+        t->pi = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Written to path.tmp and renamed over path, so an interrupted save never
+// leaves a truncated table behind
+int prime_table_save(const prime_table_t *t, const char *path) {
+    prime_table_header_t header;
+    char tmp[4096];
+    
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    FILE *fp = fopen(tmp, "wb");
+    if (fp == NULL) return -1;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PRIME_TABLE_MAGIC, sizeof(header.magic));
+    header.shift = t->shift;
+    header.limit = t->limit;
+    header.entries = t->entries;
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(t->pi, sizeof(uint64_t), t->entries, fp) == t->entries;
+    if (fclose(fp) != 0 || !ok || rename(tmp, path) != 0) {
+        int error = errno;
+        unlink(tmp);
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+// Returns 0, PRIME_TABLE_MISSING if path does not exist, or
+// PRIME_TABLE_UNUSABLE if it cannot be read or is not a complete table
+int prime_table_load(prime_table_t *t, const char *path) {
+    prime_table_header_t header;
+    FILE *fp = fopen(path, "rb");
+    
+    t->pi = NULL;
+    t->base.primes = NULL;
+    if (fp == NULL) return errno == ENOENT ? PRIME_TABLE_MISSING : PRIME_TABLE_UNUSABLE;
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        memcmp(header.magic, PRIME_TABLE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.shift < PRIME_TABLE_SHIFT || header.shift >= 64 || header.entries == 0 ||
+        header.limit != (header.entries - 1) << header.shift) {
+        fclose(fp);
+        return PRIME_TABLE_UNUSABLE;
+    }
+    t->shift = header.shift;
+    t->limit = header.limit;
+    t->entries = header.entries;
+    t->pi = (uint64_t *)malloc(t->entries * sizeof(uint64_t));
+    if (t->pi == NULL || fread(t->pi, sizeof(uint64_t), t->entries, fp) != t->entries) {
+        free(t->pi);
+        t->pi = NULL;
+        fclose(fp);
+        return PRIME_TABLE_UNUSABLE;
+    }
+    fclose(fp);
+    if (prime_table_init_base(t) != 0) {
+        free(t->pi);
+        t->pi = NULL;
+        return PRIME_TABLE_UNUSABLE;
+    }
+    return 0;
+}
+
+void prime_table_free(prime_table_t *t) {
+    free(t->pi);
+    t->pi = NULL;
+    base_primes_free(&t->base);
+    t->base.primes = NULL;
+}
+
+// Primes below x: nearest checkpoint, plus or minus the residual. Past the
+// table it sieves on from the last checkpoint. -1 if out of memory.
+long long prime_count_below(const prime_table_t *t, uint64_t x) {
+    uint64_t step = 1ULL << t->shift;
+    uint64_t i = x >> t->shift;
+    if (i >= t->entries) i = t->entries - 1;
+    uint64_t c = i << t->shift;
+    
+    long long residual;
+    if (x - c > step / 2 && i + 1 < t->entries) {
+        residual = prime_table_count(t, x, c + step);
+        return residual < 0 ? -1 : (long long)t->pi[i + 1] - residual;
+    }
+    residual = prime_table_count(t, c, x);
+    return residual < 0 ? -1 : (long long)t->pi[i] + residual;
+}
+
+// pi(x): primes <= x
+long long prime_pi(const prime_table_t *t, uint64_t x) {
+    return prime_count_below(t, x + 1);
+}
+
+// Primes in [a, b]
+long long prime_count_range(const prime_table_t *t, uint64_t a, uint64_t b) {
+    if (b < a) return 0;
+    long long below_a = prime_count_below(t, a), upto_b = prime_count_below(t, b + 1);
+    return below_a < 0 || upto_b < 0 ? -1 : upto_b - below_a;
+}
+
+// All primes in [a, b] in order, in a malloc'd array of *count entries:
+// the same per-segment counts, exclusive scan and parallel writes as
+// find_primes_parallel. NULL if out of memory.
+uint64_t *primes_between(uint64_t a, uint64_t b, long long *count) {
+    *count = 0;
+    if (b < a) return (uint64_t *)malloc(sizeof(uint64_t));
+    
+    uint64_t lo = a, hi = b + 1;
+    uint64_t num_segments = sieve_segments(lo, hi);
+    sieve_store_ctx_t ctx = {(uint64_t *)malloc((num_segments + 1) * SIEVE_SEGMENT_BYTES),
+                             (int64_t *)malloc((num_segments + 1) * sizeof(int64_t)), lo, hi};
+    int64_t *offsets = (int64_t *)malloc((num_segments + 1) * sizeof(int64_t));
+    uint64_t *primes = NULL;
+    int has_two = lo <= 2 && hi > 2;
+    
+    if (ctx.bitmap != NULL && ctx.counts != NULL && offsets != NULL &&
+        sieve_range(lo, hi, sieve_store_visit, &ctx) == 0) {
+        scan_i64(ctx.counts, offsets, num_segments, SCAN_EXCLUSIVE);
+        *count = has_two + offsets[num_segments - 1] + ctx.counts[num_segments - 1];
+        primes = (uint64_t *)malloc((*count > 0 ? *count : 1) * sizeof(uint64_t));
+    }
+    if (primes != NULL) {
+        if (has_two) primes[0] = 2;
+        uint64_t first = sieve_first(lo);
+        #pragma omp parallel for schedule(static)
+        for (uint64_t seg = 0; seg < num_segments; seg++) {
+            sieve_segment_emit_u64(ctx.bitmap + seg * SIEVE_SEGMENT_WORDS, first + seg * SIEVE_SEGMENT_SPAN,
+                                   lo, hi, primes + has_two + offsets[seg], ctx.counts[seg]);
+        }
+    } else {
+        *count = 0;
+    }
+    free(ctx.bitmap);
+    free(ctx.counts);
+    free(offsets);
+    return primes;
+}
+
+// The k-th (1-based) odd prime of a segment
+static uint64_t sieve_segment_select(const uint64_t *bits, uint64_t seg_lo, long long k) {
+    for (int w = 0; w < SIEVE_SEGMENT_WORDS; w++) {
+        uint64_t clear = ~bits[w];
+        long long here = __builtin_popcountll(clear);
+        if (k > here) {
+            k -= here;
+            continue;
+        }
+        while (--k > 0) clear &= clear - 1;
+        return seg_lo + 2 * (w * 64ULL + __builtin_ctzll(clear)) + 1;
+    }
+    return 0;
+}
+
+// The n-th prime (1-based): binary search for the last checkpoint below
+// it, then sieve forward one step at a time. 0 if out of memory.
+uint64_t nth_prime(const prime_table_t *t, long long n) {
+    uint64_t step = 1ULL << t->shift;
+    uint64_t segs = step / SIEVE_SEGMENT_SPAN;
+    
+    if (n < 1) return 0;
+    if (n == 1) return 2;
+    
+    uint64_t lo = 0, hi = t->entries - 1; // last i with pi[i] < n
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo + 1) / 2;
+        if ((long long)t->pi[mid] < n) lo = mid;
+        else hi = mid - 1;
+    }
+    long long need = n - (long long)t->pi[lo] - (lo == 0 ? 1 : 0); // 2 is not in the bitmap
+    
+    sieve_store_ctx_t ctx = {(uint64_t *)malloc(segs * SIEVE_SEGMENT_BYTES),
+                             (int64_t *)malloc(segs * sizeof(int64_t)), 0, 0};
+    uint64_t result = 0;
+    for (uint64_t c = lo << t->shift; ctx.bitmap != NULL && ctx.counts != NULL; c += step) {
+        ctx.lo = c;
+        ctx.hi = c + step;
+        if (prime_table_sieve(t, c, c + step, sieve_store_visit, &ctx) != 0) break;
+        uint64_t s = 0;
+        while (s < segs && ctx.counts[s] < need) need -= ctx.counts[s++];
+        if (s < segs) {
+            result = sieve_segment_select(ctx.bitmap + s * SIEVE_SEGMENT_WORDS,
+                                          c + s * SIEVE_SEGMENT_SPAN, need);
+            break;
+        }
+    }
+    free(ctx.bitmap);
+    free(ctx.counts);
+    return result;
+}
+
+// Load the table (or build and persist it), then time queries against it
+void print_query_analysis(harness_t *h, int max_exponent, const char *path) {
+    // p(10^k), k = 1 .. 10
+    static const uint64_t known_nth[] = {29ULL, 541ULL, 7919ULL, 104729ULL, 1299709ULL,
+                                         15485863ULL, 179424673ULL, 2038074743ULL,
+                                         22801763489ULL, 252097800623ULL};
+    static const long long known_pi[] = {4LL, 25LL, 168LL, 1229LL, 9592LL, 78498LL, 664579LL,
+                                         5761455LL, 50847534LL, 455052511LL, 4118054813LL,
+                                         37607912018LL};
+    const int queries = HARNESS_MAX_TRIALS;
+    double samples[HARNESS_MAX_TRIALS];
+    static harness_counters_t counters; // reset before every query region
+    harness_stats_t stats;
+    prime_table_t table;
+    uint64_t limit = 1;
+    for (int k = 0; k < max_exponent && k < 12; k++) limit *= 10;
+    
+    printf("\n============================================================\n");
+    printf("Prime queries (checkpoint every 2^%d integers)\n", PRIME_TABLE_SHIFT);
+    printf("============================================================\n");
+    
+    double start = harness_now();
+    int loaded = prime_table_load(&table, path);
+    if (loaded == PRIME_TABLE_UNUSABLE) {
+        // Never overwrite a file that is not ours, e.g. a mistyped path
+        printf("'%s' cannot be read as a complete prime table; leaving it alone\n", path);
+        return;
+    }
+    if (loaded == 0 && table.limit >= limit) {
+        printf("Table: %s, %llu checkpoints up to %llu, loaded in %.6f s\n", path,
+               (unsigned long long)table.entries, (unsigned long long)table.limit,
+               harness_now() - start);
+    } else {
+        prime_table_free(&table);
+        if (prime_table_build(&table, limit, PRIME_TABLE_SHIFT) != 0) {
+            printf("Cannot build a checkpoint table up to %llu\n", (unsigned long long)limit);
+            return;
+        }
+        printf("Table: %llu checkpoints up to %llu, built in %.6f s", (unsigned long long)table.entries,
+               (unsigned long long)table.limit, harness_now() - start);
+        if (prime_table_save(&table, path) == 0) printf(", saved to %s\n", path);
+        else printf(", not saved (%s: %s)\n", path, strerror(errno));
+    }
+    
+    printf("%-24s %16s %12s %6s\n", "Query", "Answer", "Time (us)", "Check");
+    uint64_t x = 1;
+    for (int k = 1; k <= max_exponent && k <= 12; k++) {
+        x *= 10;
+        long long count = 0;
+        memset(&counters, 0, sizeof(counters));
+        for (int trial = -h->warmup; trial < h->trials; trial++) {
+            start = harness_start(h, trial);
+            count = prime_pi(&table, x);
+            harness_stop(h, trial, start, samples, &counters);
+        }
+        harness_summarize(samples, h->trials, &stats);
+        harness_record_t record = {"query", "pi", NULL, (long long)x, 1, 0.0, NULL, &counters};
+        harness_emit(h, &record, &stats);
+        char query[32];
+        snprintf(query, sizeof(query), "pi(10^%d)", k);
+        printf("%-24s %16lld %12.1f %6s\n", query, count, stats.median * 1e6,
+               count == known_pi[k - 1] ? "ok" : "FAIL");
+    }
+    long long n = 1;
+    for (int k = 1; k <= 10; k++) {
+        n *= 10;
+        if (known_nth[k - 1] > table.limit) break;
+        uint64_t p = 0;
+        memset(&counters, 0, sizeof(counters));
+        for (int trial = -h->warmup; trial < h->trials; trial++) {
+            start = harness_start(h, trial);
+            p = nth_prime(&table, n);
+            harness_stop(h, trial, start, samples, &counters);
+        }
+        harness_summarize(samples, h->trials, &stats);
+        harness_record_t record = {"query", "nth_prime", NULL, n, omp_get_max_threads(), 0.0, NULL,
+                                   &counters};
+        harness_emit(h, &record, &stats);
+        char query[32];
+        snprintf(query, sizeof(query), "nth_prime(10^%d)", k);
+        printf("%-24s %16llu %12.1f %6s\n", query, (unsigned long long)p, stats.median * 1e6,
+               p == known_nth[k - 1] ? "ok" : "FAIL");
+    }
+    
+    // A range around the middle of the table: listed and counted agree
+    uint64_t half = table.limit / 4 < 500000 ? table.limit / 4 : 500000;
+    uint64_t a = table.limit / 2 - half, b = table.limit / 2 + half;
+    long long listed = 0, counted = 0;
+    uint64_t *range = NULL;
+    memset(&counters, 0, sizeof(counters));
+    for (int trial = -h->warmup; trial < h->trials; trial++) {
+        free(range);
+        start = harness_start(h, trial);
+        range = primes_between(a, b, &listed);
+        harness_stop(h, trial, start, samples, &counters);
+    }
+    harness_summarize(samples, h->trials, &stats);
+    harness_record_t list_record = {"query", "primes_between", NULL, (long long)(b - a),
+                                    omp_get_max_threads(), 0.0, NULL, &counters};
+    harness_emit(h, &list_record, &stats);
+    double list_time = stats.median;
+    memset(&counters, 0, sizeof(counters));
+    for (int trial = -h->warmup; trial < h->trials; trial++) {
+        start = harness_start(h, trial);
+        counted = prime_count_range(&table, a, b);
+        harness_stop(h, trial, start, samples, &counters);
+    }
+    harness_summarize(samples, h->trials, &stats);
+    harness_record_t count_record = {"query", "prime_count_range", NULL, (long long)(b - a), 1,
+                                     0.0, NULL, &counters};
+    harness_emit(h, &count_record, &stats);
+    double count_time = stats.median;
+    if (range != NULL) {
+        printf("Primes in [%llu, %llu]: %lld listed in %.1f us, %lld counted in %.1f us: %s\n",
+               (unsigned long long)a, (unsigned long long)b, listed, list_time * 1e6, counted,
+               count_time * 1e6, listed == counted ? "ok" : "FAIL");
+        if (listed > 0) {
+            printf("  first %llu, last %llu\n", (unsigned long long)range[0],
+                   (unsigned long long)range[listed - 1]);
+        }
+    }
+    free(range);
+    
+    // Random pi(x) over the table, one sample per query
+    memset(&counters, 0, sizeof(counters));
+    for (int q = 0; q < queries; q++) {
+        uint32_t r[4];
+        philox4x32(q, 2, PRNG_DEFAULT_SEED, r);
+        uint64_t xq = ((uint64_t)r[0] << 32 | r[1]) % (table.limit + 1);
+        start = harness_start(h, q);
+        prime_pi(&table, xq);
+        harness_stop(h, q, start, samples, &counters);
+    }
+    harness_summarize(samples, queries, &stats);
+    harness_record_t random_record = {"query", "pi random", NULL, (long long)table.limit, 1, 0.0,
+                                      NULL, &counters};
+    harness_emit(h, &random_record, &stats);
+    printf("%d random pi(x) queries: median %.1f us, p95 %.1f us\n", queries,
+           stats.median * 1e6, stats.p95 * 1e6);
+    
+    // Spot checks against a sieve from 2 that does not use the table, on
+    // both sides of a checkpoint (3 << 19) and between checkpoints
+    static const uint64_t spot[] = {7919ULL, 1572861ULL, 1572867ULL, 12345679ULL, 98765431ULL};
+    int checked = 0, mismatches = 0;
+    for (int i = 0; i < (int)(sizeof(spot) / sizeof(spot[0])); i++) {
+        if (spot[i] > table.limit) continue;
+        checked++;
+        if (prime_pi(&table, spot[i]) != sieve_count(0, spot[i] + 1)) mismatches++;
+    }
+    printf("pi(x) spot checks against a direct sieve: %d of %d agree: %s\n", checked - mismatches,
+           checked, mismatches == 0 ? "ok" : "FAIL");
+    
+    prime_table_free(&table);
 }
 
 // Display results
@@ -99,13 +1065,41 @@ void display_results(int target_count, int *primes, double seq_time, double par_
     }
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    // Optional: largest power of ten for the pi(x) and query tables
+    // (default 10^10), the checkpoint table file, and the harness options
+    // --warmup N --trials N --output FILE anywhere
+    harness_t harness;
+    harness_init(&harness, "lab3_primes");
+    int max_exponent = 10, positional = 0;
+    const char *table_path = PRIME_TABLE_FILE;
+    for (int i = 1; i < argc; i++) {
+        int harness_arg = harness_parse_arg(&harness, argc, argv, &i);
+        if (harness_arg < 0) {
+            printf("Invalid value for %s\n", argv[i - 1]);
+            return 1;
+        } else if (harness_arg == 0 && positional == 0 && argv[i][0] != '-') {
+            max_exponent = atoi(argv[i]);
+            positional++;
+        } else if (harness_arg == 0 && positional == 1 && argv[i][0] != '-') {
+            table_path = argv[i];
+            positional++;
+        } else if (harness_arg == 0) {
+            printf("Usage: %s [MAX_EXPONENT] [TABLE_FILE] %s\n", argv[0], harness_usage());
+            return 1;
+        }
+    }
+    if (harness_open(&harness) != 0) {
+        printf("Cannot write '%s' (use a .csv or .json file)\n", harness.output);
+        return 1;
+    }
     int test_sizes[] = {10, 100, 1000, 10000, 100000};
     int num_tests = sizeof(test_sizes) / sizeof(test_sizes[0]);
     
     // Get number of threads
     int num_threads = omp_get_max_threads();
     printf("Using OpenMP with %d threads\n", num_threads);
+    printf("Trials: %d after %d warmup (times are medians)\n", harness.trials, harness.warmup);
     
     for (int i = 0; i < num_tests; i++) {
         int target = test_sizes[i];
@@ -113,32 +1107,63 @@ int main() {
         // Allocate memory for primes
         int *primes_seq = (int*)malloc(target * sizeof(int));
         int *primes_par = (int*)malloc(target * sizeof(int));
+        if (primes_seq == NULL || primes_par == NULL) {
+            printf("Memory allocation failed for %d primes\n", target);
+            free(primes_seq);
+            free(primes_par);
+            continue;
+        }
         
-        double seq_time, par_time;
+        double seq_samples[HARNESS_MAX_TRIALS], par_samples[HARNESS_MAX_TRIALS];
+        harness_counters_t seq_counters = {0}, par_counters = {0};
         
-        // Sequential execution
-        find_primes_sequential(target, primes_seq, &seq_time);
+        // Sequential and parallel execution, alternating, on the same clock
+        int failed = 0;
+        for (int trial = -harness.warmup; trial < harness.trials && !failed; trial++) {
+            double elapsed;
+            harness_counters_start(&harness, trial);
+            find_primes_sequential(target, primes_seq, &elapsed);
+            harness_counters_stop(&harness, trial, &seq_counters);
+            harness_sample(seq_samples, trial, elapsed);
+            harness_counters_start(&harness, trial);
+            failed = find_primes_parallel(target, primes_par, &elapsed) != 0;
+            harness_counters_stop(&harness, trial, &par_counters);
+            harness_sample(par_samples, trial, elapsed);
+        }
+        if (failed) {
+            printf("Parallel sieve for %d primes: memory allocation failed\n", target);
+            free(primes_seq);
+            free(primes_par);
+            continue;
+        }
         
-        // Parallel execution
-        find_primes_parallel(target, primes_par, &par_time);
+        harness_stats_t seq_stats, par_stats;
+        harness_summarize(seq_samples, harness.trials, &seq_stats);
+        harness_summarize(par_samples, harness.trials, &par_stats);
+        harness_record_t seq_record = {"primes", "trial division", NULL, target, 1, target,
+                                       "primes/s", &seq_counters};
+        harness_record_t par_record = {"primes", "segmented sieve", NULL, target, num_threads,
+                                       target, "primes/s", &par_counters};
+        harness_emit(&harness, &seq_record, &seq_stats);
+        harness_emit(&harness, &par_record, &par_stats);
+        double seq_time = seq_stats.median, par_time = par_stats.median;
         
         // Display results
         display_results(target, primes_par, seq_time, par_time);
         
         // Verify results match
-        int match = 1;
-        for (int j = 0; j < target; j++) {
-            if (primes_seq[j] != primes_par[j]) {
-                match = 0;
-                break;
-            }
-        }
+        int match = memcmp(primes_seq, primes_par, target * sizeof(int)) == 0;
         printf("Results match: %s\n", match ? "YES" : "NO");
         
         free(primes_seq);
         free(primes_par);
     }
     
+    print_sieve_analysis(&harness, max_exponent);
+    print_primality_analysis(&harness);
+    print_query_analysis(&harness, max_exponent, table_path);
+    
+    harness_close(&harness);
     return 0;
 }
 
@@ -1,170 +1,2863 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
-#include <sys/time.h>
 #include <math.h>
 #include <string.h>
 #include <getopt.h>
+#include <stdint.h>
+#include <float.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "placement.h"
+#include "prng.h"
+#include "harness.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#define omp_get_thread_num() 0 // Strassen's tasks run serially without OpenMP
+#endif
 
 #define MAX_SIZE 2048
 #define MAX_THREADS 32
 
+#define MATRIX_ALIGN 64                      // cache line / AVX-512 vector
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)   // x86-64 transparent huge page
+
+// Dense row-major matrix backed by a single aligned allocation.
+// Rows are ld doubles apart; ld >= n is padded to a whole number of cache
+// lines and nudged off power-of-two strides to avoid cache set aliasing.
+typedef struct {
+    double *data;
+    int n;
+    int ld;
+    size_t bytes;
+    int huge_pages;
+} matrix_t;
+
+#define NUM_KERNELS 3
+static const char *kernel_names[NUM_KERNELS] = {"naive", "blocked", "strassen"};
+
+#define NUM_SCHEDULES 3
+static const char *schedule_names[NUM_SCHEDULES] = {"static", "dynamic", "guided"};
+static const char *schedule_labels[NUM_SCHEDULES] = {"Static", "Dynamic", "Guided"};
+
+// Shared row dispatcher for the dynamic and guided schedules. Threads claim
+// [begin, end) ranges with a single atomic on a counter that sits on its own
+// cache line, so dispatch never takes a lock.
+typedef struct {
+    _Alignas(64) atomic_int next_row;
+    char pad[64 - sizeof(atomic_int)];
+    int n;
+    int chunk_size; // dynamic: fixed chunk, guided: minimum chunk
+    int granule;    // chunk boundaries are multiples of this (tile height)
+    int num_threads;
+    int schedule_type;
+} row_scheduler_t;
+
+#define MAT(m, i, j) ((m)->data[(size_t)(i) * (m)->ld + (j)])
+#define MAT_ROW(m, i) ((m)->data + (size_t)(i) * (m)->ld)
+
 typedef struct {
     int thread_id;
     int num_threads;
     int chunk_size;
-    int schedule_type; // 0: static, 1: dynamic
+    int schedule_type; // 0: static, 1: dynamic, 2: guided
+    row_scheduler_t *scheduler;
+    int kernel_type;   // 0: naive, 1: blocked, 2: strassen
     int n;
-    double **A;
-    double **B;
-    double **C;
+    const struct gemm_tiles *tiles;
+    const struct packed_b *packed_b; // prepared B, or NULL to pack per call
+    const matrix_t *A;
+    const matrix_t *B;
+    matrix_t *C;
+    int dtype;                       // element type, DTYPE_F64 uses A/B/C
+    const struct typed_matrix *TA;   // operands for the other element types
+    const struct typed_matrix *TB;
+    struct typed_matrix *TC;
 } thread_data_t;
 
-// Configuration structure
-typedef struct {
-    int sizes[10];
-    int num_sizes;
-    int threads[10];
-    int num_threads;
-    int chunk_sizes[10];
-    int num_chunk_sizes;
-    int schedule_types[2]; // 0=static, 1=dynamic
-    int num_schedule_types;
-    int verbose;
-    int test_all;
-} config_t;
+// Configuration structure
+typedef struct {
+    int sizes[10];
+    int num_sizes;
+    int threads[10];
+    int num_threads;
+    int chunk_sizes[10];
+    int num_chunk_sizes;
+    int schedule_types[NUM_SCHEDULES]; // 0=static, 1=dynamic, 2=guided
+    int num_schedule_types;
+    int kernel_types[NUM_KERNELS]; // 0=naive, 1=blocked, 2=strassen
+    int num_kernel_types;
+    int dtypes[8];                 // element types, see dtype_names
+    int num_dtypes;
+    int retune;
+    int strassen_cutoff;
+    int prepared_multiplies; // > 0: multiply this many A's by one prepared B
+    int batch_sizes[10];     // small-matrix sizes for the batched mode
+    int num_batch_sizes;     // > 0 selects the batched mode
+    int batch_count;
+    int sparse_patterns[3];  // > 0 patterns selects the sparse (CSR) mode
+    int num_sparse_patterns;
+    double density;          // fraction of nonzeros in sparse mode
+    int ooc_sizes[10];       // > 0 sizes selects the out-of-core mode
+    int num_ooc_sizes;
+    int ooc_tile;
+    char ooc_dir[256];
+    char ooc_inputs[512];    // "A.mat,B.mat" to multiply existing files
+    uint64_t seed;           // operand data, see prng.h
+    int warmup;              // untimed runs before the timed trials
+    int trials;              // timed runs per experiment, see harness.h
+    char output[256];        // harness records (.csv or .json), "" for none
+    int counters;            // per-thread hardware counters in the records
+    int verbose;
+    int test_all;
+    int huge_pages;
+    char isa[16];
+    char placement[64];
+} config_t;
+
+// Pick a leading dimension: whole cache lines, but never a multiple of 4 KB
+int padded_ld(int n) {
+    int per_line = MATRIX_ALIGN / sizeof(double);
+    int ld = (n + per_line - 1) / per_line * per_line;
+    if (((size_t)ld * sizeof(double)) % 4096 == 0) {
+        ld += per_line;
+    }
+    return ld;
+}
+
+matrix_t *allocate_matrix(int n, int huge_pages) {
+    matrix_t *matrix = (matrix_t *)malloc(sizeof(matrix_t));
+    if (matrix == NULL) return NULL;
+
+    matrix->n = n;
+    matrix->ld = padded_ld(n);
+    matrix->bytes = (size_t)n * matrix->ld * sizeof(double);
+    matrix->huge_pages = 0;
+
+    size_t align = MATRIX_ALIGN;
+    size_t bytes = matrix->bytes;
+    if (huge_pages && bytes >= HUGE_PAGE_SIZE) {
+        align = HUGE_PAGE_SIZE;
+        bytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    }
+
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, align, bytes) != 0) {
+        free(matrix);
+        return NULL;
+    }
+    matrix->data = (double *)ptr;
+
+#ifdef MADV_HUGEPAGE
+    // Advisory only: falls back to 4 KB pages if THP is disabled
+    if (align == HUGE_PAGE_SIZE && madvise(ptr, bytes, MADV_HUGEPAGE) == 0) {
+        matrix->huge_pages = 1;
+    }
+#endif
+    return matrix;
+}
+
+void free_matrix(matrix_t *matrix) {
+    if (matrix == NULL) return;
+    free(matrix->data);
+    free(matrix);
+}
+
+// Random operand streams (see prng.h); a prepared-B run gives its m-th A
+// the stream STREAM_PREPARED_A + m
+enum { STREAM_A, STREAM_B, STREAM_X, STREAM_SPARSE, STREAM_PREPARED_A };
+
+// Element (i, j) is element i * n + j of the stream, so the values depend
+// on neither the padded layout nor the number of OpenMP threads filling it
+void initialize_matrix(matrix_t *matrix, uint64_t seed, uint32_t stream) {
+    int n = matrix->n;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; i++) {
+        double *row = MAT_ROW(matrix, i);
+        prng_fill_uniform(row, n, seed, stream, (uint64_t)i * n, 0.0, 1.0);
+        // Keep the padding deterministic so vector loads past n are harmless
+        for (int j = n; j < matrix->ld; j++) {
+            row[j] = 0.0;
+        }
+    }
+}
+
+// Compute rows [row_begin, row_end) of C = A * B
+void multiply_rows(const matrix_t *A, const matrix_t *B, matrix_t *C,
+                   int row_begin, int row_end) {
+    int n = C->n;
+    for (int i = row_begin; i < row_end; i++) {
+        const double *a = MAT_ROW(A, i);
+        double *c = MAT_ROW(C, i);
+        for (int j = 0; j < n; j++) {
+            double sum = 0.0;
+            for (int k = 0; k < n; k++) {
+                sum += a[k] * MAT(B, k, j);
+            }
+            c[j] = sum;
+        }
+    }
+}
+
+void sequential_mm(const matrix_t *A, const matrix_t *B, matrix_t *C) {
+    multiply_rows(A, B, C, 0, C->n);
+}
+
+// ---------------------------------------------------------------------------
+// Cache-blocked kernel
+//
+// Goto-style loop nest: an nc-wide panel of B is packed so it stays in L3,
+// a kc-deep slice of it is swept by mc x kc blocks of packed A that stay in
+// L2, and the MR x NR microkernel streams a kc x NR sliver of B out of L1.
+// ---------------------------------------------------------------------------
+
+#define TILE_CACHE_FILE "matrix_mult_tiles.cfg"
+#define UKR_MAX_MR 8
+#define UKR_MAX_NR 16
+
+// C[0:m, 0:n] += a_sliver * b_sliver for one mr x nr register tile
+typedef void (*microkernel_fn)(int kc, const double *a, const double *b,
+                               double *c, int ldc, int m, int n);
+
+typedef struct {
+    const char *name;
+    int mr;
+    int nr;
+    microkernel_fn fn;
+} microkernel_t;
+
+typedef struct gemm_tiles {
+    int mc; // rows of A per packed block (L2)
+    int kc; // shared dimension per packed block (L1)
+    int nc; // columns of B per packed panel (L3)
+    const microkernel_t *ukr;
+} gemm_tiles_t;
+
+// Per-thread packing buffers, sized for the largest tiles in use
+typedef struct {
+    double *a_pack;
+    double *b_pack;
+} gemm_workspace_t;
+
+// Add a finished register tile to C, clipping it at the matrix edge
+static void store_tile(const double *acc, int nr, double *c, int ldc, int m, int n) {
+    for (int r = 0; r < m; r++) {
+        for (int q = 0; q < n; q++) {
+            c[(size_t)r * ldc + q] += acc[r * nr + q];
+        }
+    }
+}
+
+#define SCALAR_MR 4
+#define SCALAR_NR 8
+
+static void microkernel_scalar(int kc, const double *a, const double *b,
+                               double *c, int ldc, int m, int n) {
+    double acc[SCALAR_MR * SCALAR_NR] = {0.0};
+
+    for (int p = 0; p < kc; p++) {
+        for (int r = 0; r < SCALAR_MR; r++) {
+            double a_rp = a[r];
+            for (int q = 0; q < SCALAR_NR; q++) {
+                acc[r * SCALAR_NR + q] += a_rp * b[q];
+            }
+        }
+        a += SCALAR_MR;
+        b += SCALAR_NR;
+    }
+    store_tile(acc, SCALAR_NR, c, ldc, m, n);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_MICROKERNELS 1
+
+// SSE2: 4x4 tile in 8 xmm accumulators, separate multiply and add
+__attribute__((target("sse2")))
+static void microkernel_sse2(int kc, const double *a, const double *b,
+                             double *c, int ldc, int m, int n) {
+    __m128d acc[4][2];
+    for (int r = 0; r < 4; r++) {
+        acc[r][0] = _mm_setzero_pd();
+        acc[r][1] = _mm_setzero_pd();
+    }
+
+    for (int p = 0; p < kc; p++) {
+        __m128d b0 = _mm_loadu_pd(b);
+        __m128d b1 = _mm_loadu_pd(b + 2);
+        for (int r = 0; r < 4; r++) {
+            __m128d a_rp = _mm_set1_pd(a[r]);
+            acc[r][0] = _mm_add_pd(acc[r][0], _mm_mul_pd(a_rp, b0));
+            acc[r][1] = _mm_add_pd(acc[r][1], _mm_mul_pd(a_rp, b1));
+        }
+        a += 4;
+        b += 4;
+    }
+
+    if (m == 4 && n == 4) {
+        for (int r = 0; r < 4; r++) {
+            double *c_r = c + (size_t)r * ldc;
+            _mm_storeu_pd(c_r, _mm_add_pd(_mm_loadu_pd(c_r), acc[r][0]));
+            _mm_storeu_pd(c_r + 2, _mm_add_pd(_mm_loadu_pd(c_r + 2), acc[r][1]));
+        }
+    } else {
+        double tile[4 * 4];
+        for (int r = 0; r < 4; r++) {
+            _mm_storeu_pd(tile + r * 4, acc[r][0]);
+            _mm_storeu_pd(tile + r * 4 + 2, acc[r][1]);
+        }
+        store_tile(tile, 4, c, ldc, m, n);
+    }
+}
+
+// AVX2 + FMA: 6x8 tile in 12 ymm accumulators
+__attribute__((target("avx2,fma")))
+static void microkernel_avx2(int kc, const double *a, const double *b,
+                             double *c, int ldc, int m, int n) {
+    __m256d acc[6][2];
+    for (int r = 0; r < 6; r++) {
+        acc[r][0] = _mm256_setzero_pd();
+        acc[r][1] = _mm256_setzero_pd();
+    }
+
+    for (int p = 0; p < kc; p++) {
+        __m256d b0 = _mm256_loadu_pd(b);
+        __m256d b1 = _mm256_loadu_pd(b + 4);
+        for (int r = 0; r < 6; r++) {
+            __m256d a_rp = _mm256_broadcast_sd(a + r);
+            acc[r][0] = _mm256_fmadd_pd(a_rp, b0, acc[r][0]);
+            acc[r][1] = _mm256_fmadd_pd(a_rp, b1, acc[r][1]);
+        }
+        a += 6;
+        b += 8;
+    }
+
+    if (m == 6 && n == 8) {
+        for (int r = 0; r < 6; r++) {
+            double *c_r = c + (size_t)r * ldc;
+            _mm256_storeu_pd(c_r, _mm256_add_pd(_mm256_loadu_pd(c_r), acc[r][0]));
+            _mm256_storeu_pd(c_r + 4, _mm256_add_pd(_mm256_loadu_pd(c_r + 4), acc[r][1]));
+        }
+    } else {
+        double tile[6 * 8];
+        for (int r = 0; r < 6; r++) {
+            _mm256_storeu_pd(tile + r * 8, acc[r][0]);
+            _mm256_storeu_pd(tile + r * 8 + 4, acc[r][1]);
+        }
+        store_tile(tile, 8, c, ldc, m, n);
+    }
+}
+
+// AVX-512: 8x16 tile in 16 zmm accumulators
+__attribute__((target("avx512f")))
+static void microkernel_avx512(int kc, const double *a, const double *b,
+                               double *c, int ldc, int m, int n) {
+    __m512d acc[8][2];
+    for (int r = 0; r < 8; r++) {
+        acc[r][0] = _mm512_setzero_pd();
+        acc[r][1] = _mm512_setzero_pd();
+    }
+
+    for (int p = 0; p < kc; p++) {
+        __m512d b0 = _mm512_loadu_pd(b);
+        __m512d b1 = _mm512_loadu_pd(b + 8);
+        for (int r = 0; r < 8; r++) {
+            __m512d a_rp = _mm512_set1_pd(a[r]);
+            acc[r][0] = _mm512_fmadd_pd(a_rp, b0, acc[r][0]);
+            acc[r][1] = _mm512_fmadd_pd(a_rp, b1, acc[r][1]);
+        }
+        a += 8;
+        b += 16;
+    }
+
+    if (m == 8 && n == 16) {
+        for (int r = 0; r < 8; r++) {
+            double *c_r = c + (size_t)r * ldc;
+            _mm512_storeu_pd(c_r, _mm512_add_pd(_mm512_loadu_pd(c_r), acc[r][0]));
+            _mm512_storeu_pd(c_r + 8, _mm512_add_pd(_mm512_loadu_pd(c_r + 8), acc[r][1]));
+        }
+    } else {
+        double tile[8 * 16];
+        for (int r = 0; r < 8; r++) {
+            _mm512_storeu_pd(tile + r * 16, acc[r][0]);
+            _mm512_storeu_pd(tile + r * 16 + 8, acc[r][1]);
+        }
+        store_tile(tile, 16, c, ldc, m, n);
+    }
+}
+#endif
+
+// Ordered from most to least preferred
+static const microkernel_t microkernels[] = {
+#ifdef HAVE_X86_MICROKERNELS
+    {"avx512", 8, 16, microkernel_avx512},
+    {"avx2", 6, 8, microkernel_avx2},
+    {"sse2", 4, 4, microkernel_sse2},
+#endif
+    {"scalar", SCALAR_MR, SCALAR_NR, microkernel_scalar},
+};
+#define NUM_MICROKERNELS ((int)(sizeof(microkernels) / sizeof(microkernels[0])))
+
+int microkernel_supported(const microkernel_t *ukr) {
+#ifdef HAVE_X86_MICROKERNELS
+    __builtin_cpu_init();
+    if (strcmp(ukr->name, "avx512") == 0) return __builtin_cpu_supports("avx512f");
+    if (strcmp(ukr->name, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    }
+    if (strcmp(ukr->name, "sse2") == 0) return __builtin_cpu_supports("sse2");
+#endif
+    return strcmp(ukr->name, "scalar") == 0;
+}
+
+// Pick the named microkernel, or the best one this CPU supports for "auto"
+const microkernel_t *select_microkernel(const char *isa) {
+    for (int i = 0; i < NUM_MICROKERNELS; i++) {
+        const microkernel_t *ukr = &microkernels[i];
+        if ((strcmp(isa, "auto") == 0 || strcmp(isa, ukr->name) == 0) &&
+            microkernel_supported(ukr)) {
+            return ukr;
+        }
+    }
+    return NULL;
+}
+
+static long cache_size(int name, long fallback) {
+    long size = sysconf(name);
+    return size > 0 ? size : fallback;
+}
+
+static int round_to(int value, int multiple) {
+    int rounded = (value + multiple / 2) / multiple * multiple;
+    return rounded < multiple ? multiple : rounded;
+}
+
+// Analytical starting point derived from the cache hierarchy
+void default_tiles(gemm_tiles_t *tiles, const microkernel_t *ukr) {
+    long l1 = cache_size(_SC_LEVEL1_DCACHE_SIZE, 32 * 1024);
+    long l2 = cache_size(_SC_LEVEL2_CACHE_SIZE, 256 * 1024);
+    long l3 = cache_size(_SC_LEVEL3_CACHE_SIZE, 8 * 1024 * 1024);
+
+    tiles->ukr = ukr;
+    // B sliver (kc x NR) fills half of L1
+    tiles->kc = round_to((int)(l1 / 2 / (ukr->nr * sizeof(double))), 16);
+    // A block (mc x kc) fills half of L2
+    tiles->mc = round_to((int)(l2 / 2 / (tiles->kc * sizeof(double))), ukr->mr);
+    // B panel (kc x nc) fills half of L3
+    tiles->nc = round_to((int)(l3 / 2 / (tiles->kc * sizeof(double))), ukr->nr);
+    if (tiles->nc > 4096) tiles->nc = 4096;
+}
+
+int gemm_workspace_init(gemm_workspace_t *ws, const gemm_tiles_t *tiles) {
+    int mr = tiles->ukr->mr, nr = tiles->ukr->nr;
+    size_t a_bytes = (size_t)round_to(tiles->mc + mr - 1, mr) * tiles->kc * sizeof(double);
+    size_t b_bytes = (size_t)round_to(tiles->nc + nr - 1, nr) * tiles->kc * sizeof(double);
+    void *a = NULL, *b = NULL;
+
+    if (posix_memalign(&a, MATRIX_ALIGN, a_bytes) != 0) return -1;
+    if (posix_memalign(&b, MATRIX_ALIGN, b_bytes) != 0) {
+        free(a);
+        return -1;
+    }
+    ws->a_pack = (double *)a;
+    ws->b_pack = (double *)b;
+    return 0;
+}
+
+void gemm_workspace_free(gemm_workspace_t *ws) {
+    free(ws->a_pack);
+    free(ws->b_pack);
+}
+
+// Pack an mc x kc block of A into mr-row slivers, zero-padding the last one
+static void pack_a(const matrix_t *A, int row, int col, int mc, int kc, int mr, double *dst) {
+    for (int i = 0; i < mc; i += mr) {
+        int rows = mc - i < mr ? mc - i : mr;
+        for (int p = 0; p < kc; p++) {
+            for (int r = 0; r < rows; r++) {
+                dst[r] = MAT(A, row + i + r, col + p);
+            }
+            for (int r = rows; r < mr; r++) {
+                dst[r] = 0.0;
+            }
+            dst += mr;
+        }
+    }
+}
+
+// Pack a kc x nc panel of B into nr-column slivers, zero-padding the last one
+static void pack_b(const matrix_t *B, int row, int col, int kc, int nc, int nr, double *dst) {
+    for (int j = 0; j < nc; j += nr) {
+        int cols = nc - j < nr ? nc - j : nr;
+        for (int p = 0; p < kc; p++) {
+            const double *b = &MAT(B, row + p, col + j);
+            for (int c = 0; c < cols; c++) {
+                dst[c] = b[c];
+            }
+            for (int c = cols; c < nr; c++) {
+                dst[c] = 0.0;
+            }
+            dst += nr;
+        }
+    }
+}
+
+struct packed_b;
+static const double *packed_b_panel(const struct packed_b *pb, int jc_block, int pc_block);
+
+// Blocked loop nest over rows [row_begin, row_end). B panels are packed on
+// the fly into ws->b_pack, or taken from a prepared operand when one is given.
+// With accumulate set the product is added to C instead of overwriting it.
+static void blocked_rows_impl(const matrix_t *A, const matrix_t *B, const struct packed_b *packed,
+                              matrix_t *C, int row_begin, int row_end,
+                              const gemm_tiles_t *tiles, gemm_workspace_t *ws, int accumulate) {
+    int n = C->n;
+    int MR = tiles->ukr->mr, NR = tiles->ukr->nr;
+    microkernel_fn microkernel = tiles->ukr->fn;
+
+    for (int i = row_begin; i < row_end && !accumulate; i++) {
+        memset(MAT_ROW(C, i), 0, n * sizeof(double));
+    }
+
+    for (int jc = 0; jc < n; jc += tiles->nc) {
+        int nc = n - jc < tiles->nc ? n - jc : tiles->nc;
+
+        for (int pc = 0; pc < n; pc += tiles->kc) {
+            int kc = n - pc < tiles->kc ? n - pc : tiles->kc;
+            const double *b_panel = ws->b_pack;
+            if (packed != NULL) {
+                b_panel = packed_b_panel(packed, jc / tiles->nc, pc / tiles->kc);
+            } else {
+                pack_b(B, pc, jc, kc, nc, NR, ws->b_pack);
+            }
+
+            for (int ic = row_begin; ic < row_end; ic += tiles->mc) {
+                int mc = row_end - ic < tiles->mc ? row_end - ic : tiles->mc;
+                pack_a(A, ic, pc, mc, kc, MR, ws->a_pack);
+
+                for (int jr = 0; jr < nc; jr += NR) {
+                    int nr = nc - jr < NR ? nc - jr : NR;
+                    const double *b = b_panel + (size_t)jr * kc;
+
+                    for (int ir = 0; ir < mc; ir += MR) {
+                        int mr = mc - ir < MR ? mc - ir : MR;
+                        microkernel(kc, ws->a_pack + (size_t)ir * kc, b,
+                                    &MAT(C, ic + ir, jc + jr), C->ld, mr, nr);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Compute rows [row_begin, row_end) of C = A * B with the blocked loop nest
+void blocked_rows(const matrix_t *A, const matrix_t *B, matrix_t *C,
+                  int row_begin, int row_end,
+                  const gemm_tiles_t *tiles, gemm_workspace_t *ws) {
+    blocked_rows_impl(A, B, NULL, C, row_begin, row_end, tiles, ws, 0);
+}
+
+// Rows [row_begin, row_end) of C += A * B
+void blocked_rows_accumulate(const matrix_t *A, const matrix_t *B, matrix_t *C,
+                             int row_begin, int row_end,
+                             const gemm_tiles_t *tiles, gemm_workspace_t *ws) {
+    blocked_rows_impl(A, B, NULL, C, row_begin, row_end, tiles, ws, 1);
+}
+
+// ---------------------------------------------------------------------------
+// Prepared (pre-packed) B operand
+//
+// When many A matrices are multiplied by the same B, every kc x nc panel of
+// B is packed once into the microkernel's sliver layout and reused by every
+// later multiply, so the O(n^2) packing cost is paid once, not per call.
+// ---------------------------------------------------------------------------
+
+typedef struct packed_b {
+    double *data;
+    size_t *offsets;    // start of panel (jc block, pc block), jc-major
+    int n;
+    int num_jc;
+    int num_pc;
+    gemm_tiles_t tiles; // tiling the panels were packed for
+} packed_b_t;
+
+// Allocate storage for a packed copy of B; the panels are filled by
+// packed_b_pack_panels so the work can be split across threads
+packed_b_t *packed_b_create(int n, const gemm_tiles_t *tiles) {
+    packed_b_t *pb = (packed_b_t *)calloc(1, sizeof(packed_b_t));
+    if (pb == NULL) return NULL;
+
+    int nr = tiles->ukr->nr;
+    pb->n = n;
+    pb->tiles = *tiles;
+    pb->num_jc = (n + tiles->nc - 1) / tiles->nc;
+    pb->num_pc = (n + tiles->kc - 1) / tiles->kc;
+    pb->offsets = (size_t *)malloc((size_t)pb->num_jc * pb->num_pc * sizeof(size_t));
+
+    size_t total = 0;
+    for (int jb = 0; jb < pb->num_jc && pb->offsets != NULL; jb++) {
+        int nc = n - jb * tiles->nc < tiles->nc ? n - jb * tiles->nc : tiles->nc;
+        int nc_padded = (nc + nr - 1) / nr * nr;
+        for (int pb_idx = 0; pb_idx < pb->num_pc; pb_idx++) {
+            int kc = n - pb_idx * tiles->kc < tiles->kc ? n - pb_idx * tiles->kc : tiles->kc;
+            pb->offsets[jb * pb->num_pc + pb_idx] = total;
+            total += (size_t)kc * nc_padded;
+        }
+    }
+
+    void *data = NULL;
+    if (pb->offsets == NULL || posix_memalign(&data, MATRIX_ALIGN, total * sizeof(double)) != 0) {
+        free(pb->offsets);
+        free(pb);
+        return NULL;
+    }
+    pb->data = (double *)data;
+    return pb;
+}
+
+// Pack panels first, first + step, first + 2 * step, ... of B
+void packed_b_pack_panels(packed_b_t *pb, const matrix_t *B, int first, int step) {
+    const gemm_tiles_t *tiles = &pb->tiles;
+    int n = pb->n;
+
+    for (int p = first; p < pb->num_jc * pb->num_pc; p += step) {
+        int jc = (p / pb->num_pc) * tiles->nc;
+        int pc = (p % pb->num_pc) * tiles->kc;
+        int nc = n - jc < tiles->nc ? n - jc : tiles->nc;
+        int kc = n - pc < tiles->kc ? n - pc : tiles->kc;
+        pack_b(B, pc, jc, kc, nc, tiles->ukr->nr, pb->data + pb->offsets[p]);
+    }
+}
+
+void packed_b_free(packed_b_t *pb) {
+    if (pb == NULL) return;
+    free(pb->data);
+    free(pb->offsets);
+    free(pb);
+}
+
+// Rows [row_begin, row_end) of C = A * B, reading B from its prepared form
+void blocked_rows_prepared(const matrix_t *A, const packed_b_t *pb, matrix_t *C,
+                           int row_begin, int row_end, gemm_workspace_t *ws) {
+    blocked_rows_impl(A, NULL, pb, C, row_begin, row_end, &pb->tiles, ws, 0);
+}
+
+static const double *packed_b_panel(const packed_b_t *pb, int jc_block, int pc_block) {
+    return pb->data + pb->offsets[jc_block * pb->num_pc + pc_block];
+}
+
+// ---------------------------------------------------------------------------
+// Correctness check against the scalar reference
+// ---------------------------------------------------------------------------
+
+#define VERIFY_ROWS 16
+
+// Relative error allowed for an n-term dot product with a different
+// summation order (FMA contraction, blocked accumulation)
+double gemm_tolerance(int n) {
+    return 16.0 * n * DBL_EPSILON;
+}
+
+// Max relative error of C against the i-j-k reference on sampled rows
+// (first, last and evenly spaced in between) so large runs stay cheap
+double verify_result(const matrix_t *A, const matrix_t *B, const matrix_t *C) {
+    int n = C->n;
+    int samples = n < VERIFY_ROWS ? n : VERIFY_ROWS;
+    double max_err = 0.0;
+
+    for (int s = 0; s < samples; s++) {
+        int i = samples == 1 ? 0 : (int)((long)s * (n - 1) / (samples - 1));
+        const double *a = MAT_ROW(A, i);
+        for (int j = 0; j < n; j++) {
+            double ref = 0.0, mag = 0.0;
+            for (int k = 0; k < n; k++) {
+                ref += a[k] * MAT(B, k, j);
+                mag += fabs(a[k] * MAT(B, k, j));
+            }
+            double err = mag > 0.0 ? fabs(MAT(C, i, j) - ref) / mag : fabs(MAT(C, i, j));
+            if (err > max_err) max_err = err;
+        }
+    }
+    return max_err;
+}
+
+// Run the selected microkernel on awkward sizes with tiny tiles so every
+// edge path is exercised before it is trusted with a benchmark
+int self_test_microkernel(const microkernel_t *ukr) {
+    const int sizes[] = {1, 7, 33, 70};
+    gemm_tiles_t tiles = {2 * ukr->mr + 1, 19, 3 * ukr->nr - 1, ukr};
+    int ok = 1;
+
+    gemm_workspace_t ws;
+    if (gemm_workspace_init(&ws, &tiles) != 0) return 0;
+
+    for (int s = 0; s < 4 && ok; s++) {
+        int n = sizes[s];
+        matrix_t *A = allocate_matrix(n, 0);
+        matrix_t *B = allocate_matrix(n, 0);
+        matrix_t *C = allocate_matrix(n, 0);
+        if (A == NULL || B == NULL || C == NULL) {
+            ok = 0;
+        } else {
+            initialize_matrix(A, PRNG_DEFAULT_SEED, STREAM_A);
+            initialize_matrix(B, PRNG_DEFAULT_SEED, STREAM_B);
+            blocked_rows(A, B, C, 0, n, &tiles, &ws);
+            ok = verify_result(A, B, C) <= gemm_tolerance(n);
+        }
+        free_matrix(A);
+        free_matrix(B);
+        free_matrix(C);
+    }
+    gemm_workspace_free(&ws);
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Reduced-precision and integer kernels
+//
+// f32 accumulates in float, "mixed" stores f32 but accumulates in double,
+// and i16/i8 accumulate in int32. They all share the row schedulers with
+// the f64 path and run an i-k-j loop whose inner j loop the compiler turns
+// into SIMD (target_clones picks AVX-512, AVX2 or baseline at load time).
+// ---------------------------------------------------------------------------
+
+#define NUM_DTYPES 5
+enum { DTYPE_F64, DTYPE_F32, DTYPE_MIXED, DTYPE_I16, DTYPE_I8 };
+static const char *dtype_names[NUM_DTYPES] = {"f64", "f32", "mixed", "i16", "i8"};
+static const int dtype_in_size[NUM_DTYPES] = {8, 4, 4, 2, 1};  // A and B elements
+static const int dtype_out_size[NUM_DTYPES] = {8, 4, 4, 4, 4}; // C elements
+
+// Row-major matrix of any element type, rows padded to whole cache lines
+typedef struct typed_matrix {
+    void *data;
+    int n;
+    int ld;        // in elements
+    int elem_size;
+    size_t bytes;
+} typed_matrix_t;
+
+#define TYPED_ROW(m, type, i) ((type *)(m)->data + (size_t)(i) * (m)->ld)
+
+typed_matrix_t *allocate_typed_matrix(int n, int elem_size) {
+    typed_matrix_t *matrix = (typed_matrix_t *)malloc(sizeof(typed_matrix_t));
+    if (matrix == NULL) return NULL;
+
+    int per_line = MATRIX_ALIGN / elem_size;
+    matrix->n = n;
+    matrix->elem_size = elem_size;
+    matrix->ld = (n + per_line - 1) / per_line * per_line;
+    if (((size_t)matrix->ld * elem_size) % 4096 == 0) {
+        matrix->ld += per_line;
+    }
+    matrix->bytes = (size_t)n * matrix->ld * elem_size;
+
+    if (posix_memalign(&matrix->data, MATRIX_ALIGN, matrix->bytes) != 0) {
+        free(matrix);
+        return NULL;
+    }
+    memset(matrix->data, 0, matrix->bytes);
+    return matrix;
+}
+
+void free_typed_matrix(typed_matrix_t *matrix) {
+    if (matrix == NULL) return;
+    free(matrix->data);
+    free(matrix);
+}
+
+// Integer ranges keep every n <= MAX_SIZE dot product inside int32:
+// 127^2 * 2048 < 2^25 for i8 and 512^2 * 2048 < 2^30 for i16
+void initialize_typed_matrix(typed_matrix_t *matrix, int dtype, uint64_t seed, uint32_t stream) {
+    int n = matrix->n;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            double u = prng_uniform(seed, stream, (uint64_t)i * n + j);
+            switch (dtype) {
+                case DTYPE_F32:
+                case DTYPE_MIXED:
+                    TYPED_ROW(matrix, float, i)[j] = (float)u;
+                    break;
+                case DTYPE_I16:
+                    TYPED_ROW(matrix, int16_t, i)[j] = (int16_t)((int)(u * 1025) - 512);
+                    break;
+                case DTYPE_I8:
+                    TYPED_ROW(matrix, int8_t, i)[j] = (int8_t)((int)(u * 255) - 127);
+                    break;
+            }
+        }
+    }
+}
+
+static double typed_get(const typed_matrix_t *m, int dtype, int i, int j) {
+    switch (dtype) {
+        case DTYPE_I16: return TYPED_ROW(m, int16_t, i)[j];
+        case DTYPE_I8:  return TYPED_ROW(m, int8_t, i)[j];
+        default:        return TYPED_ROW(m, float, i)[j];
+    }
+}
+
+static double typed_get_output(const typed_matrix_t *m, int dtype, int i, int j) {
+    if (dtype == DTYPE_I16 || dtype == DTYPE_I8) return TYPED_ROW(m, int32_t, i)[j];
+    return TYPED_ROW(m, float, i)[j];
+}
+
+#define TYPED_J_BLOCK 512
+
+// C rows [row_begin, row_end) = A * B in i-k-j order. j is blocked so the
+// accumulator row and the streamed B segment stay in L1.
+#define DEFINE_TYPED_ROWS(NAME, IN_T, ACC_T, OUT_T)                           \
+__attribute__((target_clones("avx512f", "avx2", "default")))                  \
+static void NAME(const typed_matrix_t *A, const typed_matrix_t *B,            \
+                 typed_matrix_t *C, int row_begin, int row_end) {             \
+    int n = C->n;                                                             \
+    ACC_T acc[TYPED_J_BLOCK];                                                 \
+    for (int i = row_begin; i < row_end; i++) {                               \
+        const IN_T *a = TYPED_ROW(A, IN_T, i);                                \
+        OUT_T *c = TYPED_ROW(C, OUT_T, i);                                    \
+        for (int jb = 0; jb < n; jb += TYPED_J_BLOCK) {                       \
+            int width = n - jb < TYPED_J_BLOCK ? n - jb : TYPED_J_BLOCK;      \
+            for (int j = 0; j < width; j++) acc[j] = 0;                       \
+            for (int k = 0; k < n; k++) {                                     \
+                ACC_T a_ik = (ACC_T)a[k];                                     \
+                const IN_T *restrict b = TYPED_ROW(B, IN_T, k) + jb;          \
+                for (int j = 0; j < width; j++) {                             \
+                    acc[j] += a_ik * (ACC_T)b[j];                             \
+                }                                                             \
+            }                                                                 \
+            for (int j = 0; j < width; j++) c[jb + j] = (OUT_T)acc[j];        \
+        }                                                                     \
+    }                                                                         \
+}
+
+DEFINE_TYPED_ROWS(typed_rows_f32, float, float, float)
+DEFINE_TYPED_ROWS(typed_rows_mixed, float, double, float)
+DEFINE_TYPED_ROWS(typed_rows_i16, int16_t, int32_t, int32_t)
+DEFINE_TYPED_ROWS(typed_rows_i8, int8_t, int32_t, int32_t)
+
+void typed_rows(int dtype, const typed_matrix_t *A, const typed_matrix_t *B,
+                typed_matrix_t *C, int row_begin, int row_end) {
+    switch (dtype) {
+        case DTYPE_F32:   typed_rows_f32(A, B, C, row_begin, row_end); break;
+        case DTYPE_MIXED: typed_rows_mixed(A, B, C, row_begin, row_end); break;
+        case DTYPE_I16:   typed_rows_i16(A, B, C, row_begin, row_end); break;
+        case DTYPE_I8:    typed_rows_i8(A, B, C, row_begin, row_end); break;
+    }
+}
+
+// Integers must match exactly. f32 may drift by n * eps(float); mixed only
+// rounds once when the double accumulator is stored as float.
+double typed_tolerance(int dtype, int n) {
+    switch (dtype) {
+        case DTYPE_F32:   return 16.0 * n * FLT_EPSILON;
+        case DTYPE_MIXED: return FLT_EPSILON + gemm_tolerance(n);
+        default:          return 0.0;
+    }
+}
+
+// Max relative error on sampled rows against a double-precision reference
+// computed from the same (converted) inputs
+double verify_typed_result(int dtype, const typed_matrix_t *A, const typed_matrix_t *B,
+                           const typed_matrix_t *C) {
+    int n = C->n;
+    int samples = n < VERIFY_ROWS ? n : VERIFY_ROWS;
+    double max_err = 0.0;
+
+    for (int s = 0; s < samples; s++) {
+        int i = samples == 1 ? 0 : (int)((long)s * (n - 1) / (samples - 1));
+        for (int j = 0; j < n; j++) {
+            double ref = 0.0, mag = 0.0;
+            for (int k = 0; k < n; k++) {
+                double prod = typed_get(A, dtype, i, k) * typed_get(B, dtype, k, j);
+                ref += prod;
+                mag += fabs(prod);
+            }
+            double diff = fabs(typed_get_output(C, dtype, i, j) - ref);
+            double err = mag > 0.0 ? diff / mag : diff;
+            if (err > max_err) max_err = err;
+        }
+    }
+    return max_err;
+}
+
+void scheduler_init(row_scheduler_t *sched, int n, int chunk_size, int granule,
+                    int num_threads, int schedule_type) {
+    atomic_init(&sched->next_row, 0);
+    sched->n = n;
+    sched->chunk_size = chunk_size < 1 ? 1 : chunk_size;
+    sched->granule = granule < 1 ? 1 : granule;
+    sched->num_threads = num_threads;
+    sched->schedule_type = schedule_type;
+}
+
+// Claim the next range of rows; returns 0 once every row has been handed out
+int scheduler_next(row_scheduler_t *sched, int *begin, int *end) {
+    int start;
+    int size = sched->chunk_size;
+
+    if (sched->schedule_type == 2) { // Guided: remaining / threads, shrinking
+        start = atomic_load_explicit(&sched->next_row, memory_order_relaxed);
+        do {
+            if (start >= sched->n) return 0;
+            size = (sched->n - start) / sched->num_threads;
+            size = (size + sched->granule - 1) / sched->granule * sched->granule;
+            if (size < sched->chunk_size) size = sched->chunk_size;
+        } while (!atomic_compare_exchange_weak_explicit(&sched->next_row, &start, start + size,
+                                                        memory_order_relaxed, memory_order_relaxed));
+    } else { // Dynamic: fixed-size chunks
+        start = atomic_fetch_add_explicit(&sched->next_row, size, memory_order_relaxed);
+        if (start >= sched->n) return 0;
+    }
+
+    *begin = start;
+    *end = start + size < sched->n ? start + size : sched->n;
+    return 1;
+}
+
+static void compute_rows(thread_data_t *data, gemm_workspace_t *ws, int begin, int end) {
+    if (data->dtype != DTYPE_F64) {
+        typed_rows(data->dtype, data->TA, data->TB, data->TC, begin, end);
+    } else if (data->kernel_type == 1 && data->packed_b != NULL) {
+        blocked_rows_prepared(data->A, data->packed_b, data->C, begin, end, ws);
+    } else if (data->kernel_type == 1) {
+        blocked_rows(data->A, data->B, data->C, begin, end, data->tiles, ws);
+    } else {
+        multiply_rows(data->A, data->B, data->C, begin, end);
+    }
+}
+
+void *parallel_mm(void *arg) {
+    thread_data_t *data = (thread_data_t *)arg;
+    int n = data->n;
+    gemm_workspace_t ws = {NULL, NULL};
+
+    if (data->kernel_type == 1 && gemm_workspace_init(&ws, data->tiles) != 0) {
+        fprintf(stderr, "Thread %d: packing buffer allocation failed\n", data->thread_id);
+        return NULL;
+    }
+    
+    if (data->schedule_type == 0) { // Static scheduling
+        for (int i = data->thread_id * data->chunk_size; i < n; i += data->num_threads * data->chunk_size) {
+            int end = i + data->chunk_size < n ? i + data->chunk_size : n;
+            compute_rows(data, &ws, i, end);
+        }
+    } else { // Dynamic and guided scheduling through the shared dispatcher
+        int begin, end;
+        while (scheduler_next(data->scheduler, &begin, &end)) {
+            compute_rows(data, &ws, begin, end);
+        }
+    }
+
+    if (data->kernel_type == 1) {
+        gemm_workspace_free(&ws);
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Tile auto-tuning
+//
+// Tiles are tuned once per host by coordinate descent around the analytical
+// defaults and cached in TILE_CACHE_FILE, keyed by hostname and microkernel.
+// ---------------------------------------------------------------------------
+
+#define TUNE_SIZE 384
+
+static void tile_cache_key(char *key, size_t len, const microkernel_t *ukr) {
+    char host[128] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    snprintf(key, len, "%s:%s", host, ukr->name);
+}
+
+int load_tiles(gemm_tiles_t *tiles, const microkernel_t *ukr) {
+    char key[192], file_key[192];
+    FILE *fp = fopen(TILE_CACHE_FILE, "r");
+    if (fp == NULL) return -1;
+
+    tile_cache_key(key, sizeof(key), ukr);
+    gemm_tiles_t t;
+    t.ukr = ukr;
+    int found = -1;
+    while (fscanf(fp, "%191s %d %d %d", file_key, &t.mc, &t.kc, &t.nc) == 4) {
+        if (strcmp(file_key, key) == 0 && t.mc > 0 && t.kc > 0 && t.nc > 0) {
+            *tiles = t;
+            found = 0;
+        }
+    }
+    fclose(fp);
+    return found;
+}
+
+void save_tiles(const gemm_tiles_t *tiles) {
+    char key[192];
+    FILE *fp = fopen(TILE_CACHE_FILE, "a");
+    if (fp == NULL) return;
+
+    tile_cache_key(key, sizeof(key), tiles->ukr);
+    fprintf(fp, "%s %d %d %d\n", key, tiles->mc, tiles->kc, tiles->nc);
+    fclose(fp);
+}
+
+static double time_tiles(const matrix_t *A, const matrix_t *B, matrix_t *C,
+                         const gemm_tiles_t *tiles) {
+    gemm_workspace_t ws;
+    if (gemm_workspace_init(&ws, tiles) != 0) return 1e30;
+
+    double best = 1e30;
+    for (int rep = 0; rep < 2; rep++) {
+        double start = harness_now();
+        blocked_rows(A, B, C, 0, C->n, tiles, &ws);
+        double elapsed = harness_now() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    gemm_workspace_free(&ws);
+    return best;
+}
+
+void tune_tiles(gemm_tiles_t *tiles, const microkernel_t *ukr, int verbose) {
+    gemm_tiles_t best;
+    default_tiles(&best, ukr);
+
+    matrix_t *A = allocate_matrix(TUNE_SIZE, 0);
+    matrix_t *B = allocate_matrix(TUNE_SIZE, 0);
+    matrix_t *C = allocate_matrix(TUNE_SIZE, 0);
+    if (A == NULL || B == NULL || C == NULL) {
+        free_matrix(A);
+        free_matrix(B);
+        free_matrix(C);
+        *tiles = best;
+        return;
+    }
+    initialize_matrix(A, PRNG_DEFAULT_SEED, STREAM_A);
+    initialize_matrix(B, PRNG_DEFAULT_SEED, STREAM_B);
+
+    double best_time = time_tiles(A, B, C, &best);
+    const double scales[] = {0.5, 0.75, 1.5, 2.0};
+
+    // One pass per dimension, innermost (L1) first
+    for (int dim = 0; dim < 3; dim++) {
+        gemm_tiles_t base = best;
+        for (int s = 0; s < 4; s++) {
+            gemm_tiles_t cand = base;
+            if (dim == 0) cand.kc = round_to((int)(base.kc * scales[s]), 16);
+            if (dim == 1) cand.mc = round_to((int)(base.mc * scales[s]), ukr->mr);
+            if (dim == 2) cand.nc = round_to((int)(base.nc * scales[s]), ukr->nr);
+
+            double t = time_tiles(A, B, C, &cand);
+            if (t < best_time) {
+                best_time = t;
+                best = cand;
+            }
+        }
+    }
+
+    if (verbose) {
+        printf("Tuned %s tiles: mc=%d kc=%d nc=%d (%.2f GFLOP/s at n=%d)\n",
+               ukr->name, best.mc, best.kc, best.nc,
+               2.0 * TUNE_SIZE * TUNE_SIZE * TUNE_SIZE / best_time * 1e-9, TUNE_SIZE);
+    }
+
+    free_matrix(A);
+    free_matrix(B);
+    free_matrix(C);
+    *tiles = best;
+}
+
+// Load cached tiles for this host, tuning and caching them on first use
+void setup_tiles(gemm_tiles_t *tiles, const microkernel_t *ukr, int retune, int verbose) {
+    if (!retune && load_tiles(tiles, ukr) == 0) {
+        if (verbose) {
+            printf("Loaded %s tiles from %s: mc=%d kc=%d nc=%d\n",
+                   ukr->name, TILE_CACHE_FILE, tiles->mc, tiles->kc, tiles->nc);
+        }
+        return;
+    }
+    tune_tiles(tiles, ukr, verbose);
+    save_tiles(tiles);
+}
+
+// ---------------------------------------------------------------------------
+// Strassen engine
+//
+// Seven half-size products per level instead of eight, recursing until a
+// block is no larger than the cutoff and then falling back to the blocked
+// kernel. The top STRASSEN_TASK_DEPTH levels spawn their products as OpenMP
+// tasks, which idle threads pick up from the runtime's task pool; deeper
+// levels run depth-first inside their task to bound temporary memory.
+// Sizes that do not halve evenly are zero-padded to cutoff * 2^levels.
+// ---------------------------------------------------------------------------
+
+#define STRASSEN_TASK_DEPTH 2
+
+// Submatrix view sharing the parent's storage and leading dimension
+static matrix_t quadrant(const matrix_t *m, int qi, int qj) {
+    matrix_t view = *m;
+    view.n = m->n / 2;
+    view.data = m->data + (size_t)qi * view.n * m->ld + (size_t)qj * view.n;
+    return view;
+}
+
+// Z = X + sign * Y
+static void mat_add(const matrix_t *X, const matrix_t *Y, matrix_t *Z, double sign) {
+    for (int i = 0; i < Z->n; i++) {
+        const double *x = MAT_ROW(X, i);
+        const double *y = MAT_ROW(Y, i);
+        double *z = MAT_ROW(Z, i);
+        for (int j = 0; j < Z->n; j++) {
+            z[j] = x[j] + sign * y[j];
+        }
+    }
+}
+
+// Number of halvings needed before a block fits under the cutoff
+int strassen_levels(int n, int cutoff) {
+    int levels = 0;
+    while (n > cutoff) {
+        n = (n + 1) / 2;
+        levels++;
+    }
+    return levels;
+}
+
+// Strassen accumulates more rounding than the classic kernel: roughly a
+// factor of 12 per level on top of the base kernel's n * eps behaviour
+double strassen_tolerance(int n, int cutoff) {
+    return gemm_tolerance(n) * pow(12.0, strassen_levels(n, cutoff));
+}
+
+// ws holds one packing workspace per thread of the team. A leaf has no task
+// scheduling point, so it runs to completion on the thread that started it
+// and can use that thread's workspace. Returns -1 if a temporary could not
+// be allocated, in which case C is incomplete.
+static int strassen_rec(const matrix_t *A, const matrix_t *B, matrix_t *C,
+                        const gemm_tiles_t *tiles, gemm_workspace_t *ws, int cutoff, int depth) {
+    int n = C->n;
+
+    if (n <= cutoff || n % 2 != 0) {
+        blocked_rows(A, B, C, 0, n, tiles, &ws[omp_get_thread_num()]);
+        return 0;
+    }
+
+    int h = n / 2;
+    matrix_t A11 = quadrant(A, 0, 0), A12 = quadrant(A, 0, 1);
+    matrix_t A21 = quadrant(A, 1, 0), A22 = quadrant(A, 1, 1);
+    matrix_t B11 = quadrant(B, 0, 0), B12 = quadrant(B, 0, 1);
+    matrix_t B21 = quadrant(B, 1, 0), B22 = quadrant(B, 1, 1);
+    matrix_t *M[7];
+    int failed = 0;
+    for (int i = 0; i < 7; i++) {
+        M[i] = allocate_matrix(h, 0);
+        if (M[i] == NULL) failed = 1;
+    }
+    if (failed) {
+        for (int i = 0; i < 7; i++) free_matrix(M[i]);
+        return -1;
+    }
+
+    // Operand pairs for M1..M7: left = a1 + a_sign * a2, right = b1 + b_sign * b2
+    // (a NULL second operand means the quadrant is used as is)
+    const matrix_t *a1[7] = {&A11, &A21, &A11, &A22, &A11, &A21, &A12};
+    const matrix_t *a2[7] = {&A22, &A22, NULL, NULL, &A12, &A11, &A22};
+    const double a_sign[7] = {1, 1, 0, 0, 1, -1, -1};
+    const matrix_t *b1[7] = {&B11, &B11, &B12, &B21, &B22, &B11, &B21};
+    const matrix_t *b2[7] = {&B22, NULL, &B22, &B11, NULL, &B12, &B22};
+    const double b_sign[7] = {1, 0, -1, -1, 0, 1, 1};
+
+    for (int p = 0; p < 7; p++) {
+        #pragma omp task firstprivate(p) shared(failed) if(depth < STRASSEN_TASK_DEPTH)
+        {
+            matrix_t *left = NULL, *right = NULL;
+            const matrix_t *lhs = a1[p], *rhs = b1[p];
+            int ok = 1;
+            if (a2[p] != NULL) {
+                left = allocate_matrix(h, 0);
+                if (left != NULL) mat_add(a1[p], a2[p], left, a_sign[p]);
+                else ok = 0;
+                lhs = left;
+            }
+            if (b2[p] != NULL) {
+                right = allocate_matrix(h, 0);
+                if (right != NULL) mat_add(b1[p], b2[p], right, b_sign[p]);
+                else ok = 0;
+                rhs = right;
+            }
+            if (!ok || strassen_rec(lhs, rhs, M[p], tiles, ws, cutoff, depth + 1) != 0) {
+                #pragma omp atomic write
+                failed = 1;
+            }
+            free_matrix(left);
+            free_matrix(right);
+        }
+    }
+    #pragma omp taskwait
+
+    if (!failed) {
+        matrix_t C11 = quadrant(C, 0, 0), C12 = quadrant(C, 0, 1);
+        matrix_t C21 = quadrant(C, 1, 0), C22 = quadrant(C, 1, 1);
+        for (int i = 0; i < h; i++) {
+            double *c11 = MAT_ROW(&C11, i), *c12 = MAT_ROW(&C12, i);
+            double *c21 = MAT_ROW(&C21, i), *c22 = MAT_ROW(&C22, i);
+            const double *m1 = MAT_ROW(M[0], i), *m2 = MAT_ROW(M[1], i);
+            const double *m3 = MAT_ROW(M[2], i), *m4 = MAT_ROW(M[3], i);
+            const double *m5 = MAT_ROW(M[4], i), *m6 = MAT_ROW(M[5], i);
+            const double *m7 = MAT_ROW(M[6], i);
+            for (int j = 0; j < h; j++) {
+                c11[j] = m1[j] + m4[j] - m5[j] + m7[j];
+                c12[j] = m3[j] + m5[j];
+                c21[j] = m2[j] + m4[j];
+                c22[j] = m1[j] - m2[j] + m3[j] + m6[j];
+            }
+        }
+    }
+
+    for (int i = 0; i < 7; i++) {
+        free_matrix(M[i]);
+    }
+    return failed ? -1 : 0;
+}
+
+// Copy src into the top-left corner of a zeroed dst
+static void pad_copy(const matrix_t *src, matrix_t *dst) {
+    memset(dst->data, 0, dst->bytes);
+    for (int i = 0; i < src->n; i++) {
+        memcpy(MAT_ROW(dst, i), MAT_ROW(src, i), src->n * sizeof(double));
+    }
+}
+
+// Returns -1, with C incomplete, if a temporary could not be allocated
+int strassen_mm(const matrix_t *A, const matrix_t *B, matrix_t *C,
+                const gemm_tiles_t *tiles, int cutoff, int num_threads) {
+    int n = C->n;
+    int levels = strassen_levels(n, cutoff);
+    int base = n;
+    for (int l = 0; l < levels; l++) base = (base + 1) / 2;
+    int m = base << levels;
+    int status = 0;
+
+    gemm_workspace_t ws[MAX_THREADS];
+    int num_ws = 0;
+    while (num_ws < num_threads && gemm_workspace_init(&ws[num_ws], tiles) == 0) num_ws++;
+
+    const matrix_t *PA = A, *PB = B;
+    matrix_t *PC = C, *pa = NULL, *pb = NULL, *pc = NULL;
+    if (m != n) {
+        pa = allocate_matrix(m, 0);
+        pb = allocate_matrix(m, 0);
+        pc = allocate_matrix(m, 0);
+        if (pa != NULL && pb != NULL && pc != NULL) {
+            pad_copy(A, pa);
+            pad_copy(B, pb);
+        }
+        PA = pa;
+        PB = pb;
+        PC = pc;
+    }
+
+    if (num_ws < num_threads || PA == NULL || PB == NULL || PC == NULL) {
+        status = -1;
+    } else {
+        #pragma omp parallel num_threads(num_threads)
+        #pragma omp single
+        status = strassen_rec(PA, PB, PC, tiles, ws, cutoff, 0);
+    }
+
+    if (m != n) {
+        if (status == 0) {
+            for (int i = 0; i < n; i++) {
+                memcpy(MAT_ROW(C, i), MAT_ROW(PC, i), n * sizeof(double));
+            }
+        }
+        free_matrix(pa);
+        free_matrix(pb);
+        free_matrix(pc);
+    }
+    for (int i = 0; i < num_ws; i++) gemm_workspace_free(&ws[i]);
+    return status;
+}
+
+// ---------------------------------------------------------------------------
+// Persistent thread pool
+//
+// Workers are created once per thread count and parked on a barrier. Each
+// dispatch releases them through the start barrier, the calling thread
+// takes part as worker 0, and the done barrier marks completion, so the
+// timed window holds only the kernel and two barrier crossings. With a
+// placement the caller is pinned to worker 0's CPU only for the dispatch,
+// so OpenMP teams and other pools it starts later keep its own affinity.
+// ---------------------------------------------------------------------------
+
+typedef void (*pool_task_fn)(void *arg, int thread_id);
+
+typedef struct {
+    int num_threads;          // including the calling thread
+    pthread_t threads[MAX_THREADS];
+    pthread_barrier_t start_barrier;
+    pthread_barrier_t done_barrier;
+    pthread_mutex_t gate_lock;
+    pthread_cond_t gate_cond;
+    int gate;                 // 0 while workers start, then 1 to run or -1 to quit
+    pool_task_fn task;
+    void *arg;
+    int shutdown;
+    double startup_time;      // create-to-ready, reported separately
+    const placement_t *placement;
+    int caller_saved;         // caller_set holds the caller's own affinity
+    cpu_set_t caller_set;
+} thread_pool_t;
+
+typedef struct {
+    thread_pool_t *pool;
+    int thread_id;
+} pool_worker_t;
+
+static void *pool_worker(void *arg) {
+    pool_worker_t worker = *(pool_worker_t *)arg;
+    thread_pool_t *pool = worker.pool;
+    free(arg);
+
+    placement_pin_self(pool->placement, worker.thread_id);
+
+    // The barriers count every worker, so nobody waits on them until all
+    // workers exist
+    pthread_mutex_lock(&pool->gate_lock);
+    while (pool->gate == 0) pthread_cond_wait(&pool->gate_cond, &pool->gate_lock);
+    int run = pool->gate > 0;
+    pthread_mutex_unlock(&pool->gate_lock);
+    if (!run) return NULL;
+
+    pthread_barrier_wait(&pool->start_barrier); // ready
+    while (1) {
+        pthread_barrier_wait(&pool->start_barrier);
+        if (pool->shutdown) break;
+        pool->task(pool->arg, worker.thread_id);
+        pthread_barrier_wait(&pool->done_barrier);
+    }
+    return NULL;
+}
+
+thread_pool_t *thread_pool_create(int num_threads, const placement_t *placement) {
+    if (num_threads < 1 || num_threads > MAX_THREADS) return NULL;
+
+    thread_pool_t *pool = (thread_pool_t *)calloc(1, sizeof(thread_pool_t));
+    if (pool == NULL) return NULL;
+
+    double start_time = harness_now();
+    pool->num_threads = num_threads;
+    pool->placement = placement;
+    pool->caller_saved = placement->mode != PLACEMENT_NONE &&
+        pthread_getaffinity_np(pthread_self(), sizeof(pool->caller_set), &pool->caller_set) == 0;
+    pthread_barrier_init(&pool->start_barrier, NULL, num_threads);
+    pthread_barrier_init(&pool->done_barrier, NULL, num_threads);
+    pthread_mutex_init(&pool->gate_lock, NULL);
+    pthread_cond_init(&pool->gate_cond, NULL);
+
+    int started = 1;
+    while (started < num_threads) {
+        pool_worker_t *worker = (pool_worker_t *)malloc(sizeof(pool_worker_t));
+        if (worker == NULL) break;
+        worker->pool = pool;
+        worker->thread_id = started;
+        if (pthread_create(&pool->threads[started], NULL, pool_worker, worker) != 0) {
+            free(worker);
+            break;
+        }
+        started++;
+    }
+
+    // Open the gate, or send the workers that did start home
+    pthread_mutex_lock(&pool->gate_lock);
+    pool->gate = started == num_threads ? 1 : -1;
+    pthread_cond_broadcast(&pool->gate_cond);
+    pthread_mutex_unlock(&pool->gate_lock);
+    if (pool->gate < 0) {
+        for (int i = 1; i < started; i++) pthread_join(pool->threads[i], NULL);
+        pthread_barrier_destroy(&pool->start_barrier);
+        pthread_barrier_destroy(&pool->done_barrier);
+        pthread_mutex_destroy(&pool->gate_lock);
+        pthread_cond_destroy(&pool->gate_cond);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_barrier_wait(&pool->start_barrier); // every worker is running
+    pool->startup_time = harness_now() - start_time;
+    return pool;
+}
+
+// Run task(arg, id) on every pool thread and return once all have finished
+void thread_pool_run(thread_pool_t *pool, pool_task_fn task, void *arg) {
+    pool->task = task;
+    pool->arg = arg;
+    if (pool->caller_saved) placement_pin_self(pool->placement, 0); // the caller is worker 0
+    pthread_barrier_wait(&pool->start_barrier);
+    task(arg, 0);
+    pthread_barrier_wait(&pool->done_barrier);
+    if (pool->caller_saved) {
+        pthread_setaffinity_np(pthread_self(), sizeof(pool->caller_set), &pool->caller_set);
+    }
+}
+
+void thread_pool_destroy(thread_pool_t *pool) {
+    if (pool == NULL) return;
+
+    pool->shutdown = 1;
+    pthread_barrier_wait(&pool->start_barrier);
+    for (int i = 1; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_barrier_destroy(&pool->start_barrier);
+    pthread_barrier_destroy(&pool->done_barrier);
+    pthread_mutex_destroy(&pool->gate_lock);
+    pthread_cond_destroy(&pool->gate_cond);
+    free(pool);
+}
+
+// Shared state for one benchmark session: pools are created lazily, one
+// per thread count, and live until the session ends
+typedef struct {
+    const config_t *config;
+    const gemm_tiles_t *tiles;
+    placement_t placement;
+    thread_pool_t *pools[MAX_THREADS + 1];
+    harness_t harness;
+} bench_context_t;
+
+thread_pool_t *get_thread_pool(bench_context_t *ctx, int num_threads) {
+    if (num_threads < 1 || num_threads > MAX_THREADS) return NULL;
+
+    if (ctx->pools[num_threads] == NULL) {
+        ctx->pools[num_threads] = thread_pool_create(num_threads, &ctx->placement);
+        if (ctx->pools[num_threads] != NULL && ctx->config->verbose) {
+            printf("Thread pool with %d threads started in %.6f sec\n",
+                   num_threads, ctx->pools[num_threads]->startup_time);
+        }
+    }
+    return ctx->pools[num_threads];
+}
+
+void destroy_thread_pools(bench_context_t *ctx) {
+    for (int i = 0; i <= MAX_THREADS; i++) {
+        thread_pool_destroy(ctx->pools[i]);
+        ctx->pools[i] = NULL;
+    }
+}
+
+// Reduce an experiment's trials to statistics, record them in the harness
+// output and return the median time
+static double finish_trials(bench_context_t *ctx, const double *samples, int trials,
+                            const harness_record_t *record, harness_stats_t *stats) {
+    harness_summarize(samples, trials, stats);
+    harness_emit(&ctx->harness, record, stats);
+    return stats->median;
+}
+
+static void parallel_mm_task(void *arg, int thread_id) {
+    thread_data_t *thread_data = (thread_data_t *)arg;
+    parallel_mm(&thread_data[thread_id]);
+}
+
+// ---------------------------------------------------------------------------
+// First-touch placement
+//
+// Linux backs a page on the node of the thread that first writes it. With a
+// placement active, every thread zeroes the rows the static schedule gives
+// it before the values are filled in, so A and C rows land next to the
+// thread that computes them and B is spread evenly over all nodes.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    matrix_t *matrices[3];
+    int num_matrices;
+    int chunk_size;
+    int num_threads;
+    double bytes[MAX_THREADS];
+    double seconds[MAX_THREADS];
+} first_touch_t;
+
+static void first_touch_task(void *arg, int thread_id) {
+    first_touch_t *ft = (first_touch_t *)arg;
+    double start_time = harness_now();
+    double bytes = 0.0;
+
+    for (int m = 0; m < ft->num_matrices; m++) {
+        matrix_t *matrix = ft->matrices[m];
+        size_t row_bytes = (size_t)matrix->ld * sizeof(double);
+        for (int i = thread_id * ft->chunk_size; i < matrix->n; i += ft->num_threads * ft->chunk_size) {
+            int end = i + ft->chunk_size < matrix->n ? i + ft->chunk_size : matrix->n;
+            memset(MAT_ROW(matrix, i), 0, (end - i) * row_bytes);
+            bytes += (double)(end - i) * row_bytes;
+        }
+    }
+
+    ft->bytes[thread_id] = bytes;
+    ft->seconds[thread_id] = harness_now() - start_time;
+}
+
+void first_touch_matrices(bench_context_t *ctx, thread_pool_t *pool, int chunk_size,
+                          matrix_t *A, matrix_t *B, matrix_t *C) {
+    first_touch_t ft = {{A, B, C}, 3, chunk_size, pool->num_threads, {0.0}, {0.0}};
+    thread_pool_run(pool, first_touch_task, &ft);
+
+    if (ctx->config->verbose) {
+        placement_print_bandwidth(&ctx->placement, "First-touch", pool->num_threads,
+                                  ft.bytes, ft.seconds);
+        placement_print_pages(&ctx->placement, "Matrix C", C->data, C->bytes);
+    }
+}
+
+// The blocked kernel repacks B for every row range it is handed, so its
+// scheduling unit is widened towards one mc block (without starving threads)
+static int blocked_chunk(int chunk_size, int n, int num_threads, const gemm_tiles_t *tiles) {
+    int share = (n + num_threads - 1) / num_threads;
+    int unit = share < tiles->mc ? share : tiles->mc;
+    if (chunk_size > unit) unit = chunk_size;
+    int mr = tiles->ukr->mr;
+    return (unit + mr - 1) / mr * mr;
+}
+
+// Chunk size an f64 run actually uses, or 0 when the kernel ignores it:
+// one thread runs the sequential or single-workspace path, and Strassen
+// splits work into tasks
+static int effective_chunk(int chunk_size, int n, int num_threads, int kernel_type,
+                           const gemm_tiles_t *tiles) {
+    if (num_threads == 1 || kernel_type == 2) return 0;
+    if (kernel_type == 1) return blocked_chunk(chunk_size, n, num_threads, tiles);
+    return chunk_size;
+}
+
+// Index of an earlier entry of the chunk sweep that blocked_chunk rounds to
+// the same row block as entry c, or -1. Only multithreaded blocked runs
+// round the chunk; every other run is repeated as asked.
+static int repeated_blocked_chunk(const config_t *config, int n, int num_threads, int c,
+                                  const gemm_tiles_t *tiles) {
+    if (num_threads == 1) return -1;
+    int chunk = blocked_chunk(config->chunk_sizes[c], n, num_threads, tiles);
+    for (int e = 0; e < c; e++) {
+        if (blocked_chunk(config->chunk_sizes[e], n, num_threads, tiles) == chunk) return e;
+    }
+    return -1;
+}
+
+void run_experiment(bench_context_t *ctx, int n,
+                    int num_threads, int chunk_size, int schedule_type, int kernel_type) {
+    const config_t *config = ctx->config;
+    const gemm_tiles_t *tiles = ctx->tiles;
+    int verbose = config->verbose;
+    
+    // Start (or reuse) the pool before the matrices exist and before the clock
+    thread_pool_t *pool = get_thread_pool(ctx, num_threads);
+    if (pool == NULL) {
+        fprintf(stderr, "Cannot start %d threads (max %d)\n", num_threads, MAX_THREADS);
+        return;
+    }
+    
+    matrix_t *A = allocate_matrix(n, config->huge_pages);
+    matrix_t *B = allocate_matrix(n, config->huge_pages);
+    matrix_t *C = allocate_matrix(n, config->huge_pages);
+    if (A == NULL || B == NULL || C == NULL) {
+        fprintf(stderr, "Memory allocation failed for size %d\n", n);
+        free_matrix(A);
+        free_matrix(B);
+        free_matrix(C);
+        return;
+    }
+    
+    thread_data_t thread_data[MAX_THREADS];
+    memset(thread_data, 0, sizeof(thread_data));
+    
+    if (kernel_type == 1) {
+        chunk_size = blocked_chunk(chunk_size, n, num_threads, tiles);
+    }
+    // "-" where the kernel or the single-thread path ignores the chunk
+    char chunk_label[16] = "-";
+    if (effective_chunk(chunk_size, n, num_threads, kernel_type, tiles) > 0) {
+        snprintf(chunk_label, sizeof(chunk_label), "%d", chunk_size);
+    }
+    
+    if (ctx->placement.mode != PLACEMENT_NONE) {
+        first_touch_matrices(ctx, pool, chunk_size, A, B, C);
+    }
+    initialize_matrix(A, config->seed, STREAM_A);
+    initialize_matrix(B, config->seed, STREAM_B);
+    
+    row_scheduler_t scheduler;
+    
+    if (num_threads > 1) {
+        for (int i = 0; i < num_threads; i++) {
+            thread_data[i].thread_id = i;
+            thread_data[i].num_threads = num_threads;
+            thread_data[i].chunk_size = chunk_size;
+            thread_data[i].schedule_type = schedule_type;
+            thread_data[i].scheduler = &scheduler;
+            thread_data[i].kernel_type = kernel_type;
+            thread_data[i].n = n;
+            thread_data[i].tiles = tiles;
+            thread_data[i].packed_b = NULL;
+            thread_data[i].A = A;
+            thread_data[i].B = B;
+            thread_data[i].C = C;
+        }
+    }
+    
+    // Every trial recomputes all of C, so only the scheduler needs a reset
+    double samples[HARNESS_MAX_TRIALS];
+    harness_counters_t counters = {0};
+    int failed = 0;
+    for (int trial = -ctx->harness.warmup; trial < ctx->harness.trials && !failed; trial++) {
+        scheduler_init(&scheduler, n, chunk_size, kernel_type == 1 ? tiles->ukr->mr : 1,
+                       num_threads, schedule_type);
+        double start_time = harness_start(&ctx->harness, trial);
+        
+        if (kernel_type == 2) {
+            failed = strassen_mm(A, B, C, tiles, config->strassen_cutoff, num_threads) != 0;
+        } else if (num_threads == 1 && kernel_type == 1) {
+            gemm_workspace_t ws;
+            if (gemm_workspace_init(&ws, tiles) == 0) {
+                blocked_rows(A, B, C, 0, n, tiles, &ws);
+                gemm_workspace_free(&ws);
+            } else {
+                failed = 1;
+            }
+        } else if (num_threads == 1) {
+            sequential_mm(A, B, C);
+        } else {
+            thread_pool_run(pool, parallel_mm_task, thread_data);
+        }
+        
+        harness_stop(&ctx->harness, trial, start_time, samples, &counters);
+    }
+    if (failed) {
+        fprintf(stderr, "Memory allocation failed in the %s kernel for size %d\n",
+                kernel_names[kernel_type], n);
+        free_matrix(A);
+        free_matrix(B);
+        free_matrix(C);
+        return;
+    }
+    
+    double flops = 2.0 * n * n * (double)n;
+    char params[64];
+    snprintf(params, sizeof(params), "dtype=f64;chunk=%s;schedule=%s", chunk_label,
+             schedule_names[schedule_type]);
+    harness_record_t record = {"gemm", kernel_names[kernel_type], params, n, num_threads,
+                               flops * 1e-9, "GFLOP/s", &counters};
+    harness_stats_t stats;
+    double execution_time = finish_trials(ctx, samples, ctx->harness.trials, &record, &stats);
+    double gflops = flops / execution_time * 1e-9;
+    double error = verify_result(A, B, C);
+    double startup_time = pool->startup_time;
+    double tolerance = kernel_type == 2 ? strassen_tolerance(n, config->strassen_cutoff)
+                                        : gemm_tolerance(n);
+    
+    if (error > tolerance) {
+        fprintf(stderr, "WARNING: %s result for n=%d exceeds tolerance (%.2e > %.2e)\n",
+                kernel_names[kernel_type], n, error, tolerance);
+    }
+    
+    if (verbose) {
+        printf("Size: %4d, Type: f64  , Kernel: %-8s, Threads: %2d, Chunk: %3s, Schedule: %s, Time: %.6f sec, %.2f GFLOP/s, Error: %.1e\n",
+               n, kernel_names[kernel_type], num_threads, chunk_label, 
+               schedule_labels[schedule_type], execution_time, gflops, error);
+    } else {
+        printf("%d,f64,%s,%d,%s,%s,%.6f,%.2f,%.2e,%.6f\n", n, kernel_names[kernel_type], num_threads, chunk_label,
+               schedule_names[schedule_type], execution_time, gflops, error, startup_time);
+    }
+    
+    free_matrix(A);
+    free_matrix(B);
+    free_matrix(C);
+}
+
+// Reduced-precision and integer types run the i-k-j typed kernel under the
+// same pool, schedulers and chunk sizes as the f64 naive kernel
+void run_typed_experiment(bench_context_t *ctx, int dtype, int n, int num_threads,
+                          int chunk_size, int schedule_type) {
+    const config_t *config = ctx->config;
+    
+    thread_pool_t *pool = get_thread_pool(ctx, num_threads);
+    if (pool == NULL) {
+        fprintf(stderr, "Cannot start %d threads (max %d)\n", num_threads, MAX_THREADS);
+        return;
+    }
+    
+    typed_matrix_t *A = allocate_typed_matrix(n, dtype_in_size[dtype]);
+    typed_matrix_t *B = allocate_typed_matrix(n, dtype_in_size[dtype]);
+    typed_matrix_t *C = allocate_typed_matrix(n, dtype_out_size[dtype]);
+    if (A == NULL || B == NULL || C == NULL) {
+        fprintf(stderr, "Memory allocation failed for size %d\n", n);
+        free_typed_matrix(A);
+        free_typed_matrix(B);
+        free_typed_matrix(C);
+        return;
+    }
+    initialize_typed_matrix(A, dtype, config->seed, STREAM_A);
+    initialize_typed_matrix(B, dtype, config->seed, STREAM_B);
+    
+    row_scheduler_t scheduler;
+    
+    thread_data_t thread_data[MAX_THREADS];
+    memset(thread_data, 0, sizeof(thread_data));
+    for (int i = 0; i < num_threads; i++) {
+        thread_data[i].thread_id = i;
+        thread_data[i].num_threads = num_threads;
+        thread_data[i].chunk_size = chunk_size;
+        thread_data[i].schedule_type = schedule_type;
+        thread_data[i].scheduler = &scheduler;
+        thread_data[i].kernel_type = 0;
+        thread_data[i].dtype = dtype;
+        thread_data[i].n = n;
+        thread_data[i].TA = A;
+        thread_data[i].TB = B;
+        thread_data[i].TC = C;
+    }
+    
+    double samples[HARNESS_MAX_TRIALS];
+    harness_counters_t counters = {0};
+    for (int trial = -ctx->harness.warmup; trial < ctx->harness.trials; trial++) {
+        scheduler_init(&scheduler, n, chunk_size, 1, num_threads, schedule_type);
+        double start_time = harness_start(&ctx->harness, trial);
+        thread_pool_run(pool, parallel_mm_task, thread_data);
+        harness_stop(&ctx->harness, trial, start_time, samples, &counters);
+    }
+    
+    double ops = 2.0 * n * n * (double)n;
+    char params[64];
+    snprintf(params, sizeof(params), "dtype=%s;chunk=%d;schedule=%s", dtype_names[dtype],
+             chunk_size, schedule_names[schedule_type]);
+    harness_record_t record = {"gemm", "ikj", params, n, num_threads, ops * 1e-9, "GOP/s",
+                               &counters};
+    harness_stats_t stats;
+    double execution_time = finish_trials(ctx, samples, ctx->harness.trials, &record, &stats);
+    double gops = ops / execution_time * 1e-9;
+    double error = verify_typed_result(dtype, A, B, C);
+    double tolerance = typed_tolerance(dtype, n);
+    
+    if (error > tolerance) {
+        fprintf(stderr, "WARNING: %s result for n=%d exceeds tolerance (%.2e > %.2e)\n",
+                dtype_names[dtype], n, error, tolerance);
+    }
+    
+    if (config->verbose) {
+        printf("Size: %4d, Type: %-5s, Kernel: %-8s, Threads: %2d, Chunk: %3d, Schedule: %s, Time: %.6f sec, %.2f GOP/s, Error: %.1e\n",
+               n, dtype_names[dtype], "ikj", num_threads, chunk_size,
+               schedule_labels[schedule_type], execution_time, gops, error);
+    } else {
+        printf("%d,%s,%s,%d,%d,%s,%.6f,%.2f,%.2e,%.6f\n", n, dtype_names[dtype], "ikj",
+               num_threads, chunk_size, schedule_names[schedule_type], execution_time,
+               gops, error, pool->startup_time);
+    }
+    
+    free_typed_matrix(A);
+    free_typed_matrix(B);
+    free_typed_matrix(C);
+}
+
+// f64 runs the selected kernel; every other type has only the typed kernel
+void run_dtype_experiment(bench_context_t *ctx, int dtype, int n, int num_threads,
+                          int chunk_size, int schedule_type, int kernel_type) {
+    if (dtype == DTYPE_F64) {
+        run_experiment(ctx, n, num_threads, chunk_size, schedule_type, kernel_type);
+    } else {
+        run_typed_experiment(ctx, dtype, n, num_threads, chunk_size, schedule_type);
+    }
+}
+
+typedef struct {
+    packed_b_t *pb;
+    const matrix_t *B;
+    int num_threads;
+} pack_b_job_t;
+
+static void pack_b_task(void *arg, int thread_id) {
+    pack_b_job_t *job = (pack_b_job_t *)arg;
+    packed_b_pack_panels(job->pb, job->B, thread_id, job->num_threads);
+}
+
+// Multiply K different A matrices by one prepared B. Packing is timed on
+// its own; each multiply is timed without it and is one harness trial (the
+// warmup multiplies reuse the first A), and the amortized rate charges the
+// single pack to all K multiplies.
+void run_prepared_experiment(bench_context_t *ctx, int n, int num_threads,
+                             int chunk_size, int schedule_type) {
+    const config_t *config = ctx->config;
+    const gemm_tiles_t *tiles = ctx->tiles;
+    int multiplies = config->prepared_multiplies;
+    
+    thread_pool_t *pool = get_thread_pool(ctx, num_threads);
+    if (pool == NULL) {
+        fprintf(stderr, "Cannot start %d threads (max %d)\n", num_threads, MAX_THREADS);
+        return;
+    }
+    
+    matrix_t *A = allocate_matrix(n, config->huge_pages);
+    matrix_t *B = allocate_matrix(n, config->huge_pages);
+    matrix_t *C = allocate_matrix(n, config->huge_pages);
+    packed_b_t *pb = packed_b_create(n, tiles);
+    if (A == NULL || B == NULL || C == NULL || pb == NULL) {
+        fprintf(stderr, "Memory allocation failed for size %d\n", n);
+        free_matrix(A);
+        free_matrix(B);
+        free_matrix(C);
+        packed_b_free(pb);
+        return;
+    }
+    
+    // B is never repacked here, so chunks only need to align with the tile height
+    int mr = tiles->ukr->mr;
+    chunk_size = (chunk_size + mr - 1) / mr * mr;
+    
+    if (ctx->placement.mode != PLACEMENT_NONE) {
+        first_touch_matrices(ctx, pool, chunk_size, A, B, C);
+    }
+    initialize_matrix(B, config->seed, STREAM_B);
+    
+    pack_b_job_t job = {pb, B, num_threads};
+    double pack_start = harness_now();
+    thread_pool_run(pool, pack_b_task, &job);
+    double pack_time = harness_now() - pack_start;
+    
+    thread_data_t thread_data[MAX_THREADS];
+    memset(thread_data, 0, sizeof(thread_data));
+    row_scheduler_t scheduler;
+    double multiply_time = 0.0, error = 0.0;
+    double samples[HARNESS_MAX_TRIALS];
+    harness_counters_t counters = {0};
+    
+    for (int r = -ctx->harness.warmup; r < multiplies; r++) {
+        // a fresh A for every multiply, outside the timing
+        initialize_matrix(A, config->seed, STREAM_PREPARED_A + (r > 0 ? r : 0));
+        scheduler_init(&scheduler, n, chunk_size, mr, num_threads, schedule_type);
+        for (int i = 0; i < num_threads; i++) {
+            thread_data[i].thread_id = i;
+            thread_data[i].num_threads = num_threads;
+            thread_data[i].chunk_size = chunk_size;
+            thread_data[i].schedule_type = schedule_type;
+            thread_data[i].scheduler = &scheduler;
+            thread_data[i].kernel_type = 1;
+            thread_data[i].n = n;
+            thread_data[i].tiles = tiles;
+            thread_data[i].packed_b = pb;
+            thread_data[i].A = A;
+            thread_data[i].B = B;
+            thread_data[i].C = C;
+        }
+        
+        double start_time = harness_start(&ctx->harness, r);
+        thread_pool_run(pool, parallel_mm_task, thread_data);
+        double elapsed = harness_now() - start_time;
+        harness_counters_stop(&ctx->harness, r, &counters);
+        if (r < 0) continue;
+        multiply_time += elapsed;
+        harness_sample(samples, r, elapsed);
+        
+        double err = verify_result(A, B, C);
+        if (err > error) error = err;
+    }
+    
+    double flops = 2.0 * n * n * (double)n;
+    char params[64];
+    snprintf(params, sizeof(params), "chunk=%d;schedule=%s;pack_time=%.6f", chunk_size,
+             schedule_names[schedule_type], pack_time);
+    harness_record_t record = {"gemm_prepared", "blocked", params, n, num_threads, flops * 1e-9,
+                               "GFLOP/s", &counters};
+    harness_stats_t stats;
+    double per_multiply = finish_trials(ctx, samples, multiplies, &record, &stats);
+    double gflops = flops / per_multiply * 1e-9;
+    double amortized_gflops = flops * multiplies / (multiply_time + pack_time) * 1e-9;
+    
+    if (error > gemm_tolerance(n)) {
+        fprintf(stderr, "WARNING: prepared result for n=%d exceeds tolerance (%.2e > %.2e)\n",
+                n, error, gemm_tolerance(n));
+    }
+    
+    if (config->verbose) {
+        printf("Size: %4d, Threads: %2d, Chunk: %3d, Schedule: %s, Multiplies: %d, "
+               "Pack: %.6f sec, Per multiply: %.6f sec, %.2f GFLOP/s (%.2f amortized), Error: %.1e\n",
+               n, num_threads, chunk_size, schedule_labels[schedule_type], multiplies,
+               pack_time, per_multiply, gflops, amortized_gflops, error);
+    } else {
+        printf("%d,%d,%d,%s,%d,%.6f,%.6f,%.2f,%.2f,%.2e\n", n, num_threads, chunk_size,
+               schedule_names[schedule_type], multiplies, pack_time, per_multiply,
+               gflops, amortized_gflops, error);
+    }
+    
+    free_matrix(A);
+    free_matrix(B);
+    free_matrix(C);
+    packed_b_free(pb);
+}
+
+// ---------------------------------------------------------------------------
+// Batched small-matrix multiply
+//
+// Thousands of independent n x n products (n = 8..64) stored back to back
+// with a fixed stride. Parallelism comes from the batch, never from inside
+// one product, and the common sizes get kernels whose trip counts are
+// compile-time constants so the compiler fully unrolls and vectorizes them.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    double *data;
+    int n;
+    int count;
+    size_t stride; // elements from one matrix to the next (cache-line multiple)
+} matrix_batch_t;
+
+#define BATCH_MAT(b, idx) ((b)->data + (size_t)(idx) * (b)->stride)
+
+matrix_batch_t *allocate_batch(int n, int count) {
+    matrix_batch_t *batch = (matrix_batch_t *)malloc(sizeof(matrix_batch_t));
+    if (batch == NULL) return NULL;
+
+    int per_line = MATRIX_ALIGN / sizeof(double);
+    batch->n = n;
+    batch->count = count;
+    batch->stride = ((size_t)n * n + per_line - 1) / per_line * per_line;
+
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, MATRIX_ALIGN, batch->stride * count * sizeof(double)) != 0) {
+        free(batch);
+        return NULL;
+    }
+    batch->data = (double *)ptr;
+    return batch;
+}
+
+void free_batch(matrix_batch_t *batch) {
+    if (batch == NULL) return;
+    free(batch->data);
+    free(batch);
+}
+
+void initialize_batch(matrix_batch_t *batch, uint64_t seed, uint32_t stream) {
+    size_t total = batch->stride * batch->count;
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < total; i += PRNG_FILL_BLOCK) {
+        size_t count = total - i < PRNG_FILL_BLOCK ? total - i : PRNG_FILL_BLOCK;
+        prng_fill_uniform(batch->data + i, count, seed, stream, i, 0.0, 1.0);
+    }
+}
+
+typedef void (*small_gemm_fn)(const double *restrict A, const double *restrict B,
+                              double *restrict C, int n);
+
+// Any size: i-k-j order so the inner loop streams rows of B and C
+static void small_gemm_generic(const double *restrict A, const double *restrict B,
+                               double *restrict C, int n) {
+    for (int i = 0; i < n * n; i++) C[i] = 0.0;
+    for (int i = 0; i < n; i++) {
+        for (int k = 0; k < n; k++) {
+            double a = A[i * n + k];
+            for (int j = 0; j < n; j++) {
+                C[i * n + j] += a * B[k * n + j];
+            }
+        }
+    }
+}
+
+// Register-blocked 2 x 8 tile of C held in four 4-wide vectors across the
+// whole k loop. Every bound is a constant, so the loops fully unroll, and
+// target_clones builds AVX-512, AVX2 and baseline copies that are picked at
+// load time. Sizes must be multiples of 8.
+typedef double v4d __attribute__((vector_size(32)));
+
+#define DEFINE_SMALL_GEMM(N)                                                  \
+__attribute__((target_clones("avx512f", "avx2", "default")))                  \
+static void small_gemm_##N(const double *restrict A, const double *restrict B, \
+                           double *restrict C, int n) {                       \
+    (void)n;                                                                  \
+    for (int i = 0; i < N; i += 2) {                                          \
+        for (int jb = 0; jb < N; jb += 8) {                                   \
+            v4d c00 = {0}, c01 = {0}, c10 = {0}, c11 = {0};                   \
+            for (int k = 0; k < N; k++) {                                     \
+                double a0 = A[i * N + k], a1 = A[(i + 1) * N + k];            \
+                v4d va0 = {a0, a0, a0, a0}, va1 = {a1, a1, a1, a1};           \
+                v4d b0, b1;                                                   \
+                memcpy(&b0, B + k * N + jb, sizeof(v4d));                     \
+                memcpy(&b1, B + k * N + jb + 4, sizeof(v4d));                 \
+                c00 += va0 * b0;                                              \
+                c01 += va0 * b1;                                              \
+                c10 += va1 * b0;                                              \
+                c11 += va1 * b1;                                              \
+            }                                                                 \
+            memcpy(C + i * N + jb, &c00, sizeof(v4d));                        \
+            memcpy(C + i * N + jb + 4, &c01, sizeof(v4d));                    \
+            memcpy(C + (i + 1) * N + jb, &c10, sizeof(v4d));                  \
+            memcpy(C + (i + 1) * N + jb + 4, &c11, sizeof(v4d));              \
+        }                                                                     \
+    }                                                                         \
+}
+
+DEFINE_SMALL_GEMM(8)
+DEFINE_SMALL_GEMM(16)
+DEFINE_SMALL_GEMM(24)
+DEFINE_SMALL_GEMM(32)
+DEFINE_SMALL_GEMM(48)
+DEFINE_SMALL_GEMM(64)
+
+small_gemm_fn select_small_gemm(int n) {
+    switch (n) {
+        case 8:  return small_gemm_8;
+        case 16: return small_gemm_16;
+        case 24: return small_gemm_24;
+        case 32: return small_gemm_32;
+        case 48: return small_gemm_48;
+        case 64: return small_gemm_64;
+        default: return small_gemm_generic;
+    }
+}
+
+// C[i] = A[i] * B[i] for batch items [begin, end)
+void batched_gemm(const matrix_batch_t *A, const matrix_batch_t *B, matrix_batch_t *C,
+                  int begin, int end) {
+    small_gemm_fn kernel = select_small_gemm(C->n);
+    for (int idx = begin; idx < end; idx++) {
+        kernel(BATCH_MAT(A, idx), BATCH_MAT(B, idx), BATCH_MAT(C, idx), C->n);
+    }
+}
+
+// Max relative error of a sample of batch items against the i-j-k reference
+double verify_batch(const matrix_batch_t *A, const matrix_batch_t *B, const matrix_batch_t *C) {
+    int n = C->n;
+    int samples = C->count < VERIFY_ROWS ? C->count : VERIFY_ROWS;
+    double max_err = 0.0;
+
+    // Evenly spaced and distinct: every item when the batch is small
+    for (int s = 0; s < samples; s++) {
+        int idx = samples == 1 ? 0 : (int)((long)s * (C->count - 1) / (samples - 1));
+        const double *a = BATCH_MAT(A, idx), *b = BATCH_MAT(B, idx), *c = BATCH_MAT(C, idx);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                double ref = 0.0, mag = 0.0;
+                for (int k = 0; k < n; k++) {
+                    ref += a[i * n + k] * b[k * n + j];
+                    mag += fabs(a[i * n + k] * b[k * n + j]);
+                }
+                double err = mag > 0.0 ? fabs(c[i * n + j] - ref) / mag : fabs(c[i * n + j]);
+                if (err > max_err) max_err = err;
+            }
+        }
+    }
+    return max_err;
+}
+
+typedef struct {
+    const matrix_batch_t *A;
+    const matrix_batch_t *B;
+    matrix_batch_t *C;
+    row_scheduler_t *scheduler; // hands out batch items instead of rows
+    int chunk_size;
+    int num_threads;
+} batch_job_t;
+
+static void batched_gemm_task(void *arg, int thread_id) {
+    batch_job_t *job = (batch_job_t *)arg;
+    int count = job->C->count;
+
+    if (job->scheduler->schedule_type == 0) {
+        for (int i = thread_id * job->chunk_size; i < count; i += job->num_threads * job->chunk_size) {
+            int end = i + job->chunk_size < count ? i + job->chunk_size : count;
+            batched_gemm(job->A, job->B, job->C, i, end);
+        }
+    } else {
+        int begin, end;
+        while (scheduler_next(job->scheduler, &begin, &end)) {
+            batched_gemm(job->A, job->B, job->C, begin, end);
+        }
+    }
+}
+
+void run_batch_experiment(bench_context_t *ctx, int n, int num_threads,
+                          int chunk_size, int schedule_type) {
+    const config_t *config = ctx->config;
+    int count = config->batch_count;
+    
+    thread_pool_t *pool = get_thread_pool(ctx, num_threads);
+    if (pool == NULL) {
+        fprintf(stderr, "Cannot start %d threads (max %d)\n", num_threads, MAX_THREADS);
+        return;
+    }
+    
+    matrix_batch_t *A = allocate_batch(n, count);
+    matrix_batch_t *B = allocate_batch(n, count);
+    matrix_batch_t *C = allocate_batch(n, count);
+    if (A == NULL || B == NULL || C == NULL) {
+        fprintf(stderr, "Memory allocation failed for batch of %d %dx%d matrices\n", count, n, n);
+        free_batch(A);
+        free_batch(B);
+        free_batch(C);
+        return;
+    }
+    initialize_batch(A, config->seed, STREAM_A);
+    initialize_batch(B, config->seed, STREAM_B);
+    memset(C->data, 0, C->stride * count * sizeof(double));
+    
+    row_scheduler_t scheduler;
+    batch_job_t job = {A, B, C, &scheduler, chunk_size < 1 ? 1 : chunk_size, num_threads};
+    const char *kernel = select_small_gemm(n) == small_gemm_generic ? "generic" : "unrolled";
+    
+    double samples[HARNESS_MAX_TRIALS];
+    harness_counters_t counters = {0};
+    for (int trial = -ctx->harness.warmup; trial < ctx->harness.trials; trial++) {
+        scheduler_init(&scheduler, count, chunk_size, 1, num_threads, schedule_type);
+        double start_time = harness_start(&ctx->harness, trial);
+        thread_pool_run(pool, batched_gemm_task, &job);
+        harness_stop(&ctx->harness, trial, start_time, samples, &counters);
+    }
+    
+    double flops = 2.0 * n * n * (double)n * count;
+    char params[64];
+    snprintf(params, sizeof(params), "batch=%d;chunk=%d;schedule=%s", count, job.chunk_size,
+             schedule_names[schedule_type]);
+    harness_record_t record = {"gemm_batch", kernel, params, n, num_threads, flops * 1e-9,
+                               "GFLOP/s", &counters};
+    harness_stats_t stats;
+    double execution_time = finish_trials(ctx, samples, ctx->harness.trials, &record, &stats);
+    double gflops = flops / execution_time * 1e-9;
+    double error = verify_batch(A, B, C);
+    if (error > gemm_tolerance(n)) {
+        fprintf(stderr, "WARNING: batched result for n=%d exceeds tolerance (%.2e > %.2e)\n",
+                n, error, gemm_tolerance(n));
+    }
+    
+    if (config->verbose) {
+        printf("Size: %2dx%-2d, Batch: %6d, Kernel: %-9s, Threads: %2d, Chunk: %3d, Schedule: %s, "
+               "Time: %.6f sec, %.2f GFLOP/s, Error: %.1e\n",
+               n, n, count, kernel, num_threads, job.chunk_size, schedule_labels[schedule_type],
+               execution_time, gflops, error);
+    } else {
+        printf("%d,%d,%s,%d,%d,%s,%.6f,%.2f,%.2e\n", n, count, kernel,
+               num_threads, job.chunk_size, schedule_names[schedule_type],
+               execution_time, gflops, error);
+    }
+    
+    free_batch(A);
+    free_batch(B);
+    free_batch(C);
+}
+
+// ---------------------------------------------------------------------------
+// Sparse (CSR) times dense
+//
+// SpMV (y = S x) and SpMM (C = S B, B dense n x n) over a compressed sparse
+// row matrix. Rows can be handed out with the usual row schedules, or split
+// into one contiguous range per thread holding an equal share of nonzeros,
+// which is what keeps skewed (power-law) rows from serialising on one thread.
+// ---------------------------------------------------------------------------
+
+#define NUM_SPARSE_PATTERNS 3
+enum { SPARSE_UNIFORM, SPARSE_BANDED, SPARSE_POWERLAW };
+static const char *sparse_pattern_names[NUM_SPARSE_PATTERNS] = {"uniform", "banded", "powerlaw"};
+
+enum { SPARSE_SPMV, SPARSE_SPMM };
+static const char *sparse_op_names[] = {"spmv", "spmm"};
+
+#define POWERLAW_ALPHA 1.0 // row i holds ~ 1/(i+1)^alpha of the nonzeros
+#define SPMV_REPEATS 50    // one SpMV is too short to time on its own
+
+typedef struct {
+    int n;
+    int nnz;
+    int *row_ptr; // n + 1 offsets into col_idx/values
+    int *col_idx; // sorted within each row
+    double *values;
+} csr_matrix_t;
+
+void free_csr(csr_matrix_t *S) {
+    if (S == NULL) return;
+    free(S->row_ptr);
+    free(S->col_idx);
+    free(S->values);
+    free(S);
+}
+
+static int compare_int(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+// Nonzeros in row i of an n x n pattern with the given density
+static int sparse_row_length(int pattern, int n, double density, int i, double powerlaw_scale) {
+    int target = (int)(density * n + 0.5);
+    int len;
+
+    switch (pattern) {
+        case SPARSE_BANDED: {
+            int half = target / 2;
+            int lo = i - half < 0 ? 0 : i - half;
+            int hi = i + half >= n ? n - 1 : i + half;
+            return hi - lo + 1;
+        }
+        case SPARSE_POWERLAW:
+            len = (int)(powerlaw_scale / pow(i + 1, POWERLAW_ALPHA) + 0.5);
+            break;
+        default:
+            len = target;
+            break;
+    }
+    if (len < 1) len = 1;
+    return len > n ? n : len;
+}
+
+// Build a random n x n CSR matrix. Uniform and power-law rows draw distinct
+// columns with Floyd's sampling; banded rows are dense around the diagonal.
+// Draw d of nonzero slot k comes from element 2 * k + d of STREAM_SPARSE.
+csr_matrix_t *generate_csr(int pattern, int n, double density, uint64_t seed) {
+    csr_matrix_t *S = (csr_matrix_t *)calloc(1, sizeof(csr_matrix_t));
+    int *seen = (int *)malloc(n * sizeof(int));
+    if (S == NULL || seen == NULL) {
+        free(S);
+        free(seen);
+        return NULL;
+    }
+    S->n = n;
+    S->row_ptr = (int *)malloc(((size_t)n + 1) * sizeof(int));
+    if (S->row_ptr == NULL) {
+        free(seen);
+        free_csr(S);
+        return NULL;
+    }
+
+    double weight_sum = 0.0;
+    for (int i = 0; i < n; i++) weight_sum += 1.0 / pow(i + 1, POWERLAW_ALPHA);
+    double powerlaw_scale = density * n * n / weight_sum;
+
+    // Offsets are ints, so count in long long and refuse a matrix whose
+    // nonzeros would not fit
+    long long nnz = 0;
+    S->row_ptr[0] = 0;
+    for (int i = 0; i < n; i++) {
+        nnz += sparse_row_length(pattern, n, density, i, powerlaw_scale);
+        if (nnz > INT_MAX) {
+            fprintf(stderr, "Sparse size %d at density %g has more than %d nonzeros\n",
+                    n, density, INT_MAX);
+            free(seen);
+            free_csr(S);
+            return NULL;
+        }
+        S->row_ptr[i + 1] = (int)nnz;
+    }
+    S->nnz = (int)nnz;
+    S->col_idx = (int *)malloc((size_t)S->nnz * sizeof(int));
+    S->values = (double *)malloc((size_t)S->nnz * sizeof(double));
+    if (S->col_idx == NULL || S->values == NULL) {
+        free(seen);
+        free_csr(S);
+        return NULL;
+    }
+
+    for (int j = 0; j < n; j++) seen[j] = -1;
+    for (int i = 0; i < n; i++) {
+        int *cols = S->col_idx + S->row_ptr[i];
+        int len = S->row_ptr[i + 1] - S->row_ptr[i];
+
+        if (pattern == SPARSE_BANDED) {
+            int lo = i - (int)(density * n + 0.5) / 2;
+            if (lo < 0) lo = 0;
+            for (int k = 0; k < len; k++) cols[k] = lo + k;
+        } else {
+            int count = 0;
+            for (int j = n - len; j < n; j++) {
+                uint64_t slot = (uint64_t)S->row_ptr[i] + count;
+                int col = (int)(prng_uniform(seed, STREAM_SPARSE, 2 * slot) * (j + 1));
+                if (seen[col] == i) col = j;
+                seen[col] = i;
+                cols[count++] = col;
+            }
+            qsort(cols, len, sizeof(int), compare_int);
+        }
+        for (int k = 0; k < len; k++) {
+            uint64_t slot = (uint64_t)S->row_ptr[i] + k;
+            S->values[slot] = prng_uniform(seed, STREAM_SPARSE, 2 * slot + 1);
+        }
+    }
+    free(seen);
+    return S;
+}
+
+// Rows [row_begin, row_end) of y = S x; returns the nonzeros touched
+long spmv_rows(const csr_matrix_t *S, const double *restrict x, double *restrict y,
+               int row_begin, int row_end) {
+    for (int i = row_begin; i < row_end; i++) {
+        double sum = 0.0;
+        for (int k = S->row_ptr[i]; k < S->row_ptr[i + 1]; k++) {
+            sum += S->values[k] * x[S->col_idx[k]];
+        }
+        y[i] = sum;
+    }
+    return S->row_ptr[row_end] - S->row_ptr[row_begin];
+}
+
+// Rows [row_begin, row_end) of C = S B: each nonzero scales one row of B
+// into the output row, so the inner loop is a unit-stride axpy
+long spmm_rows(const csr_matrix_t *S, const matrix_t *B, matrix_t *C,
+               int row_begin, int row_end) {
+    int n = B->n;
+    for (int i = row_begin; i < row_end; i++) {
+        double *restrict c = MAT_ROW(C, i);
+        for (int j = 0; j < n; j++) c[j] = 0.0;
+        for (int k = S->row_ptr[i]; k < S->row_ptr[i + 1]; k++) {
+            double a = S->values[k];
+            const double *restrict b = MAT_ROW(B, S->col_idx[k]);
+            for (int j = 0; j < n; j++) {
+                c[j] += a * b[j];
+            }
+        }
+    }
+    return S->row_ptr[row_end] - S->row_ptr[row_begin];
+}
+
+// Split rows into num_threads contiguous ranges with ~nnz/num_threads
+// nonzeros each: bounds[t] is the first row whose offset reaches t's share
+void sparse_nnz_partition(const csr_matrix_t *S, int num_threads, int *bounds) {
+    bounds[0] = 0;
+    for (int t = 1; t < num_threads; t++) {
+        long target = (long)S->nnz * t / num_threads;
+        int lo = bounds[t - 1], hi = S->n;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (S->row_ptr[mid] < target) lo = mid + 1;
+            else hi = mid;
+        }
+        bounds[t] = lo;
+    }
+    bounds[num_threads] = S->n;
+}
+
+// Max relative error on sampled rows against a serial recomputation
+double verify_sparse(const csr_matrix_t *S, int op, const double *x, const double *y,
+                     const matrix_t *B, const matrix_t *C) {
+    int n = S->n;
+    int samples = n < VERIFY_ROWS ? n : VERIFY_ROWS;
+    int cols = op == SPARSE_SPMV ? 1 : n;
+    double max_err = 0.0;
+
+    for (int s = 0; s < samples; s++) {
+        int i = samples == 1 ? 0 : (int)((long)s * (n - 1) / (samples - 1));
+        for (int j = 0; j < cols; j++) {
+            double ref = 0.0, mag = 0.0;
+            for (int k = S->row_ptr[i]; k < S->row_ptr[i + 1]; k++) {
+                double b = op == SPARSE_SPMV ? x[S->col_idx[k]] : MAT(B, S->col_idx[k], j);
+                ref += S->values[k] * b;
+                mag += fabs(S->values[k] * b);
+            }
+            double got = op == SPARSE_SPMV ? y[i] : MAT(C, i, j);
+            double diff = fabs(got - ref);
+            double err = mag > 0.0 ? diff / mag : diff;
+            if (err > max_err) max_err = err;
+        }
+    }
+    return max_err;
+}
+
+typedef struct {
+    const csr_matrix_t *S;
+    int op;
+    const double *x;
+    double *y;
+    const matrix_t *B;
+    matrix_t *C;
+    int by_nnz;                     // 1: contiguous nonzero-balanced ranges
+    const int *bounds;              // num_threads + 1 row bounds when by_nnz
+    row_scheduler_t *scheduler;
+    int chunk_size;
+    int num_threads;
+    long nnz_done[MAX_THREADS];     // each thread's nonzeros in the latest run
+} sparse_job_t;
+
+static long sparse_range(const sparse_job_t *job, int begin, int end) {
+    if (job->op == SPARSE_SPMV) return spmv_rows(job->S, job->x, job->y, begin, end);
+    return spmm_rows(job->S, job->B, job->C, begin, end);
+}
+
+static void sparse_task(void *arg, int thread_id) {
+    sparse_job_t *job = (sparse_job_t *)arg;
+    int n = job->S->n;
+    long nnz = 0;
+
+    if (job->by_nnz) {
+        nnz = sparse_range(job, job->bounds[thread_id], job->bounds[thread_id + 1]);
+    } else if (job->scheduler->schedule_type == 0) {
+        for (int i = thread_id * job->chunk_size; i < n; i += job->num_threads * job->chunk_size) {
+            int end = i + job->chunk_size < n ? i + job->chunk_size : n;
+            nnz += sparse_range(job, i, end);
+        }
+    } else {
+        int begin, end;
+        while (scheduler_next(job->scheduler, &begin, &end)) {
+            nnz += sparse_range(job, begin, end);
+        }
+    }
+    job->nnz_done[thread_id] = nnz;
+}
+
+// One SpMV (averaged over SPMV_REPEATS per trial) or SpMM over S. by_nnz ignores the
+// schedule and chunk; the imbalance column is the busiest thread's nonzeros
+// over the mean, so 1.00 is a perfect split.
+void run_sparse_experiment(bench_context_t *ctx, const csr_matrix_t *S, int pattern, int op,
+                           int num_threads, int chunk_size, int schedule_type, int by_nnz) {
+    const config_t *config = ctx->config;
+    int n = S->n;
+    
+    thread_pool_t *pool = get_thread_pool(ctx, num_threads);
+    if (pool == NULL) {
+        fprintf(stderr, "Cannot start %d threads (max %d)\n", num_threads, MAX_THREADS);
+        return;
+    }
+    
+    double *x = NULL, *y = NULL;
+    matrix_t *B = NULL, *C = NULL;
+    if (op == SPARSE_SPMV) {
+        x = (double *)malloc(n * sizeof(double));
+        y = (double *)calloc(n, sizeof(double));
+        if (x == NULL || y == NULL) goto out;
+        prng_fill_uniform(x, n, config->seed, STREAM_X, 0, 0.0, 1.0);
+    } else {
+        B = allocate_matrix(n, config->huge_pages);
+        C = allocate_matrix(n, config->huge_pages);
+        if (B == NULL || C == NULL) goto out;
+        initialize_matrix(B, config->seed, STREAM_B);
+    }
+    
+    int bounds[MAX_THREADS + 1];
+    sparse_nnz_partition(S, num_threads, bounds);
+    
+    row_scheduler_t scheduler;
+    sparse_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.S = S;
+    job.op = op;
+    job.x = x;
+    job.y = y;
+    job.B = B;
+    job.C = C;
+    job.by_nnz = by_nnz;
+    job.bounds = bounds;
+    job.scheduler = &scheduler;
+    job.chunk_size = chunk_size < 1 ? 1 : chunk_size;
+    job.num_threads = num_threads;
+    
+    int repeats = op == SPARSE_SPMV ? SPMV_REPEATS : 1;
+    double samples[HARNESS_MAX_TRIALS];
+    harness_counters_t counters = {0};
+    for (int trial = -ctx->harness.warmup; trial < ctx->harness.trials; trial++) {
+        double start_time = harness_start(&ctx->harness, trial);
+        for (int r = 0; r < repeats; r++) {
+            scheduler_init(&scheduler, n, job.chunk_size, 1, num_threads, schedule_type);
+            thread_pool_run(pool, sparse_task, &job);
+        }
+        double elapsed = harness_now() - start_time;
+        harness_counters_stop(&ctx->harness, trial, &counters);
+        harness_sample(samples, trial, elapsed / repeats);
+    }
+    
+    const char *schedule = by_nnz ? "nnz" : schedule_names[schedule_type];
+    int chunk = by_nnz ? 0 : job.chunk_size;
+    double flops = 2.0 * S->nnz * (op == SPARSE_SPMV ? 1.0 : (double)n);
+    char params[96];
+    snprintf(params, sizeof(params), "pattern=%s;nnz=%d;chunk=%d;schedule=%s",
+             sparse_pattern_names[pattern], S->nnz, chunk, schedule);
+    harness_record_t record = {"sparse", sparse_op_names[op], params, n, num_threads,
+                               flops * 1e-9, "GFLOP/s", &counters};
+    harness_stats_t stats;
+    double execution_time = finish_trials(ctx, samples, ctx->harness.trials, &record, &stats);
+    double gflops = flops / execution_time * 1e-9;
+    long max_nnz = 0, total_nnz = 0;
+    for (int t = 0; t < num_threads; t++) {
+        if (job.nnz_done[t] > max_nnz) max_nnz = job.nnz_done[t];
+        total_nnz += job.nnz_done[t];
+    }
+    double imbalance = total_nnz > 0 ? (double)max_nnz * num_threads / total_nnz : 1.0;
+    double error = verify_sparse(S, op, x, y, B, C);
+    if (error > gemm_tolerance(n)) {
+        fprintf(stderr, "WARNING: %s result for n=%d exceeds tolerance (%.2e > %.2e)\n",
+                sparse_op_names[op], n, error, gemm_tolerance(n));
+    }
+    
+    if (config->verbose) {
+        printf("Size: %4d, Pattern: %-8s, NNZ: %8d, Op: %s, Threads: %2d, Chunk: %3d, Schedule: %-7s, "
+               "Time: %.6f sec, %.2f GFLOP/s, Imbalance: %.2f, Error: %.1e\n",
+               n, sparse_pattern_names[pattern], S->nnz, sparse_op_names[op], num_threads, chunk,
+               schedule, execution_time, gflops, imbalance, error);
+    } else {
+        printf("%d,%s,%d,%s,%d,%d,%s,%.6f,%.2f,%.2f,%.2e\n", n, sparse_pattern_names[pattern],
+               S->nnz, sparse_op_names[op], num_threads, chunk, schedule, execution_time,
+               gflops, imbalance, error);
+    }
+    
+out:
+    free(x);
+    free(y);
+    free_matrix(B);
+    free_matrix(C);
+}
+
+// ---------------------------------------------------------------------------
+// On-disk matrices and out-of-core multiply
+//
+// File layout (native byte order):
+//   [0, 4096)  matfile_header_t, zero padded to one page
+//   [4096, ..) tiles in row-major tile order; each tile is tile x tile
+//              row-major elements, edge tiles zero padded to full size
+// Every tile starts on a page boundary, so tiles are used in place through
+// mmap and can be prefetched or dropped from the resident set one at a time.
+// ---------------------------------------------------------------------------
+
+#define MATFILE_MAGIC "PPLMAT01"
+#define MATFILE_VERSION 1
+#define MATFILE_DATA_OFFSET 4096
+#define MATFILE_TILE_ALIGN 32   // 32 x 32 doubles = 8 KB, a whole number of pages
+#define OOC_VERIFY_COLS 16
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;        // dtype_names index; the multiply needs f64
+    uint64_t rows;
+    uint64_t cols;
+    uint32_t tile;         // tile edge in elements
+    uint32_t reserved;
+    uint64_t data_offset;  // bytes from the start of the file to tile (0, 0)
+} matfile_header_t;
+
+typedef struct {
+    int fd;
+    char *base;            // whole-file mapping
+    size_t bytes;
+    int writable;
+    int dtype;
+    long rows;
+    long cols;
+    int tile;
+    int tile_rows;         // tiles down
+    int tile_cols;         // tiles across
+    size_t tile_bytes;
+    size_t data_offset;
+} matfile_t;
+
+static void matfile_layout(matfile_t *mf) {
+    mf->tile_rows = (int)((mf->rows + mf->tile - 1) / mf->tile);
+    mf->tile_cols = (int)((mf->cols + mf->tile - 1) / mf->tile);
+    mf->tile_bytes = (size_t)mf->tile * mf->tile * dtype_in_size[mf->dtype];
+    mf->bytes = mf->data_offset + (size_t)mf->tile_rows * mf->tile_cols * mf->tile_bytes;
+}
+
+static int matfile_map(matfile_t *mf) {
+    int prot = PROT_READ | (mf->writable ? PROT_WRITE : 0);
+    void *base = mmap(NULL, mf->bytes, prot, MAP_SHARED, mf->fd, 0);
+    if (base == MAP_FAILED) return -1;
+    mf->base = (char *)base;
+    return 0;
+}
+
+void matfile_close(matfile_t *mf) {
+    if (mf == NULL) return;
+    if (mf->base != NULL) munmap(mf->base, mf->bytes);
+    if (mf->fd >= 0) close(mf->fd);
+    free(mf);
+}
+
+// Create a zero-filled rows x cols file and map it read-write
+matfile_t *matfile_create(const char *path, long rows, long cols, int tile, int dtype) {
+    if (rows < 1 || cols < 1 || tile < MATFILE_TILE_ALIGN || tile % MATFILE_TILE_ALIGN != 0) {
+        fprintf(stderr, "%s: tile must be a positive multiple of %d\n", path, MATFILE_TILE_ALIGN);
+        return NULL;
+    }
+    matfile_t *mf = (matfile_t *)calloc(1, sizeof(matfile_t));
+    if (mf == NULL) return NULL;
+
+    mf->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    mf->writable = 1;
+    mf->dtype = dtype;
+    mf->rows = rows;
+    mf->cols = cols;
+    mf->tile = tile;
+    mf->data_offset = MATFILE_DATA_OFFSET;
+    matfile_layout(mf);
 
-double **allocate_matrix(int n) {
-    double **matrix = (double **)malloc(n * sizeof(double *));
-    for (int i = 0; i < n; i++) {
-        matrix[i] = (double *)malloc(n * sizeof(double));
+    if (mf->fd < 0 || ftruncate(mf->fd, (off_t)mf->bytes) != 0 || matfile_map(mf) != 0) {
+        perror(path);
+        matfile_close(mf);
+        return NULL;
     }
-    return matrix;
+
+    matfile_header_t *header = (matfile_header_t *)mf->base;
+    memcpy(header->magic, MATFILE_MAGIC, sizeof(header->magic));
+    header->version = MATFILE_VERSION;
+    header->dtype = dtype;
+    header->rows = rows;
+    header->cols = cols;
+    header->tile = tile;
+    header->data_offset = mf->data_offset;
+    return mf;
 }
 
-void free_matrix(double **matrix, int n) {
-    for (int i = 0; i < n; i++) {
-        free(matrix[i]);
+// Map an existing file; returns NULL if it is missing or not a matrix file
+matfile_t *matfile_open(const char *path, int writable) {
+    matfile_t *mf = (matfile_t *)calloc(1, sizeof(matfile_t));
+    if (mf == NULL) return NULL;
+
+    matfile_header_t header;
+    mf->fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if (mf->fd < 0 || pread(mf->fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+        perror(path);
+        matfile_close(mf);
+        return NULL;
     }
-    free(matrix);
+    if (memcmp(header.magic, MATFILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != MATFILE_VERSION || header.dtype >= NUM_DTYPES ||
+        header.tile == 0 || header.tile % MATFILE_TILE_ALIGN != 0 ||
+        header.data_offset == 0 || header.data_offset % MATFILE_DATA_OFFSET != 0) {
+        fprintf(stderr, "%s: not a version %d matrix file\n", path, MATFILE_VERSION);
+        matfile_close(mf);
+        return NULL;
+    }
+
+    struct stat st;
+    mf->writable = writable;
+    mf->dtype = (int)header.dtype;
+    mf->rows = (long)header.rows;
+    mf->cols = (long)header.cols;
+    mf->tile = (int)header.tile;
+    mf->data_offset = header.data_offset;
+    matfile_layout(mf);
+    if (fstat(mf->fd, &st) != 0 || (size_t)st.st_size < mf->bytes || matfile_map(mf) != 0) {
+        fprintf(stderr, "%s: truncated or unmappable matrix file\n", path);
+        matfile_close(mf);
+        return NULL;
+    }
+    return mf;
 }
 
-void initialize_matrix(double **matrix, int n) {
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            matrix[i][j] = (double)rand() / RAND_MAX;
-        }
+static inline double *matfile_tile(const matfile_t *mf, int ti, int tj) {
+    return (double *)(mf->base + mf->data_offset +
+                      ((size_t)ti * mf->tile_cols + tj) * mf->tile_bytes);
+}
+
+static inline double matfile_at(const matfile_t *mf, long i, long j) {
+    const double *t = matfile_tile(mf, (int)(i / mf->tile), (int)(j / mf->tile));
+    return t[(i % mf->tile) * mf->tile + j % mf->tile];
+}
+
+// Ask the kernel to start reading a tile in the background
+static inline void matfile_prefetch(const matfile_t *mf, int ti, int tj) {
+    if (ti < mf->tile_rows && tj < mf->tile_cols) {
+        madvise(matfile_tile(mf, ti, tj), mf->tile_bytes, MADV_WILLNEED);
     }
 }
 
-void sequential_mm(double **A, double **B, double **C, int n) {
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            C[i][j] = 0.0;
-            for (int k = 0; k < n; k++) {
-                C[i][j] += A[i][k] * B[k][j];
+// Drop a tile from this process's resident set; dirty pages of a shared
+// mapping stay in the page cache and are written back as usual
+static inline void matfile_release(const matfile_t *mf, int ti, int tj) {
+    madvise(matfile_tile(mf, ti, tj), mf->tile_bytes, MADV_DONTNEED);
+}
+
+static inline void matfile_release_row(const matfile_t *mf, int ti) {
+    for (int tj = 0; tj < mf->tile_cols; tj++) matfile_release(mf, ti, tj);
+}
+
+// Fill a file with uniform random values, leaving the tile padding zero.
+// Element (i, j) is element i * cols + j of the stream, as in RAM.
+void matfile_fill_random(matfile_t *mf, uint64_t seed, uint32_t stream) {
+    #pragma omp parallel for collapse(2) schedule(static)
+    for (int ti = 0; ti < mf->tile_rows; ti++) {
+        for (int tj = 0; tj < mf->tile_cols; tj++) {
+            double *t = matfile_tile(mf, ti, tj);
+            long row0 = (long)ti * mf->tile, col0 = (long)tj * mf->tile;
+            long rows = mf->rows - row0 < mf->tile ? mf->rows - row0 : mf->tile;
+            long cols = mf->cols - col0 < mf->tile ? mf->cols - col0 : mf->tile;
+            for (long i = 0; i < rows; i++) {
+                prng_fill_uniform(t + i * mf->tile, cols, seed, stream,
+                                  (uint64_t)(row0 + i) * mf->cols + col0, 0.0, 1.0);
             }
+            matfile_release(mf, ti, tj);
         }
     }
 }
 
-void *parallel_mm(void *arg) {
-    thread_data_t *data = (thread_data_t *)arg;
-    int n = data->n;
-    
-    if (data->schedule_type == 0) { // Static scheduling
-        for (int i = data->thread_id * data->chunk_size; i < n; i += data->num_threads * data->chunk_size) {
-            for (int ii = i; ii < i + data->chunk_size && ii < n; ii++) {
-                for (int j = 0; j < n; j++) {
-                    data->C[ii][j] = 0.0;
-                    for (int k = 0; k < n; k++) {
-                        data->C[ii][j] += data->A[ii][k] * data->B[k][j];
-                    }
-                }
-            }
-        }
-    } else { // Dynamic scheduling
-        int next_row = 0;
-        pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-        
-        while (1) {
-            int start_row;
-            
-            pthread_mutex_lock(&mutex);
-            start_row = next_row;
-            next_row += data->chunk_size;
-            pthread_mutex_unlock(&mutex);
-            
-            if (start_row >= n) break;
-            
-            for (int i = start_row; i < start_row + data->chunk_size && i < n; i++) {
-                for (int j = 0; j < n; j++) {
-                    data->C[i][j] = 0.0;
-                    for (int k = 0; k < n; k++) {
-                        data->C[i][j] += data->A[i][k] * data->B[k][j];
-                    }
+typedef struct {
+    const matfile_t *A;
+    const matfile_t *B;
+    matfile_t *C;
+    const gemm_tiles_t *tiles;
+    row_scheduler_t *scheduler; // hands out C tiles in row-major order
+} ooc_job_t;
+
+// Each thread owns whole C tiles: C(i,j) = sum over p of A(i,p) * B(p,j),
+// with the next A and B tiles prefetched before the current pair is used.
+// The zero padding makes every tile product a full tile x tile multiply.
+// Tiles are handed out row-major, so a thread keeps its current A tile row
+// resident while its C tiles stay in that row and drops it when they leave.
+static void ooc_task(void *arg, int thread_id) {
+    ooc_job_t *job = (ooc_job_t *)arg;
+    int tile = job->C->tile;
+    int k_tiles = job->A->tile_cols;
+    gemm_workspace_t ws;
+    (void)thread_id;
+
+    if (gemm_workspace_init(&ws, job->tiles) != 0) {
+        fprintf(stderr, "Thread %d: packing buffer allocation failed\n", thread_id);
+        return;
+    }
+
+    int begin, end, held = -1; // A tile row in this thread's resident set
+    while (scheduler_next(job->scheduler, &begin, &end)) {
+        for (int t = begin; t < end; t++) {
+            int ti = t / job->C->tile_cols, tj = t % job->C->tile_cols;
+            if (held >= 0 && held != ti) matfile_release_row(job->A, held);
+            held = ti;
+            matrix_t c = {matfile_tile(job->C, ti, tj), tile, tile, job->C->tile_bytes, 0};
+
+            matfile_prefetch(job->A, ti, 0);
+            matfile_prefetch(job->B, 0, tj);
+            for (int p = 0; p < k_tiles; p++) {
+                matfile_prefetch(job->A, ti, p + 1);
+                matfile_prefetch(job->B, p + 1, tj);
+
+                matrix_t a = {matfile_tile(job->A, ti, p), tile, tile, job->A->tile_bytes, 0};
+                matrix_t b = {matfile_tile(job->B, p, tj), tile, tile, job->B->tile_bytes, 0};
+                if (p == 0) {
+                    blocked_rows(&a, &b, &c, 0, tile, job->tiles, &ws);
+                } else {
+                    blocked_rows_accumulate(&a, &b, &c, 0, tile, job->tiles, &ws);
                 }
+                matfile_release(job->B, p, tj);
             }
+            matfile_release(job->C, ti, tj);
         }
-        pthread_mutex_destroy(&mutex);
     }
-    return NULL;
+    if (held >= 0) matfile_release_row(job->A, held);
+    gemm_workspace_free(&ws);
 }
 
-double get_time() {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+// Nonzero if the open file behind mf is the file st describes
+static int matfile_is(const matfile_t *mf, const struct stat *st) {
+    struct stat mf_st;
+    return fstat(mf->fd, &mf_st) == 0 && mf_st.st_dev == st->st_dev && mf_st.st_ino == st->st_ino;
 }
 
-void run_experiment(int n, int num_threads, int chunk_size, int schedule_type, int verbose) {
-    double **A = allocate_matrix(n);
-    double **B = allocate_matrix(n);
-    double **C = allocate_matrix(n);
-    
-    initialize_matrix(A, n);
-    initialize_matrix(B, n);
-    
-    pthread_t threads[MAX_THREADS];
-    thread_data_t thread_data[MAX_THREADS];
-    
-    double start_time = get_time();
-    
-    if (num_threads == 1) {
-        sequential_mm(A, B, C, n);
-    } else {
-        for (int i = 0; i < num_threads; i++) {
-            thread_data[i].thread_id = i;
-            thread_data[i].num_threads = num_threads;
-            thread_data[i].chunk_size = chunk_size;
-            thread_data[i].schedule_type = schedule_type;
-            thread_data[i].n = n;
-            thread_data[i].A = A;
-            thread_data[i].B = B;
-            thread_data[i].C = C;
-            pthread_create(&threads[i], NULL, parallel_mm, &thread_data[i]);
-        }
-        
-        for (int i = 0; i < num_threads; i++) {
-            pthread_join(threads[i], NULL);
+// C = A * B over mapped files. C is created at c_path with A's tile size.
+// Returns the elapsed time, or a negative value on error.
+double ooc_multiply(bench_context_t *ctx, thread_pool_t *pool,
+                    const matfile_t *A, const matfile_t *B, const char *c_path, matfile_t **C_out) {
+    if (A->dtype != DTYPE_F64 || B->dtype != DTYPE_F64) {
+        fprintf(stderr, "Out-of-core multiply supports f64 files only\n");
+        return -1.0;
+    }
+    if (A->cols != B->rows || A->tile != B->tile) {
+        fprintf(stderr, "Operand shapes (%ldx%ld, tile %d) and (%ldx%ld, tile %d) do not match\n",
+                A->rows, A->cols, A->tile, B->rows, B->cols, B->tile);
+        return -1.0;
+    }
+    // Creating C truncates c_path, which must not destroy an operand
+    struct stat c_st;
+    if (stat(c_path, &c_st) == 0 && (matfile_is(A, &c_st) || matfile_is(B, &c_st))) {
+        fprintf(stderr, "%s is an input of the multiply; not overwriting it\n", c_path);
+        return -1.0;
+    }
+    matfile_t *C = matfile_create(c_path, A->rows, B->cols, A->tile, DTYPE_F64);
+    if (C == NULL) return -1.0;
+
+    row_scheduler_t scheduler;
+    scheduler_init(&scheduler, C->tile_rows * C->tile_cols, 1, 1, pool->num_threads, 1);
+    ooc_job_t job = {A, B, C, ctx->tiles, &scheduler};
+
+    double start_time = harness_now();
+    thread_pool_run(pool, ooc_task, &job);
+    msync(C->base, C->bytes, MS_SYNC);
+    double elapsed = harness_now() - start_time;
+
+    *C_out = C;
+    return elapsed;
+}
+
+// Max relative error of sampled C entries against a serial dot product;
+// the A and B tiles it reads are dropped again as it goes
+double verify_ooc(const matfile_t *A, const matfile_t *B, const matfile_t *C) {
+    int row_samples = C->rows < VERIFY_ROWS ? (int)C->rows : VERIFY_ROWS;
+    int col_samples = C->cols < OOC_VERIFY_COLS ? (int)C->cols : OOC_VERIFY_COLS;
+    double max_err = 0.0;
+
+    for (int s = 0; s < row_samples; s++) {
+        long i = row_samples == 1 ? 0 : (long)s * (C->rows - 1) / (row_samples - 1);
+        for (int r = 0; r < col_samples; r++) {
+            long j = col_samples == 1 ? 0 : (long)r * (C->cols - 1) / (col_samples - 1);
+            double ref = 0.0, mag = 0.0;
+            for (long k = 0; k < A->cols; k++) {
+                double prod = matfile_at(A, i, k) * matfile_at(B, k, j);
+                ref += prod;
+                mag += fabs(prod);
+            }
+            double diff = fabs(matfile_at(C, i, j) - ref);
+            double err = mag > 0.0 ? diff / mag : diff;
+            if (err > max_err) max_err = err;
+            for (int kt = 0; kt < B->tile_rows; kt++) matfile_release(B, kt, (int)(j / B->tile));
         }
+        matfile_release_row(A, (int)(i / A->tile));
     }
-    
-    double end_time = get_time();
-    double execution_time = end_time - start_time;
-    
-    if (verbose) {
-        printf("Size: %4d, Threads: %2d, Chunk: %3d, Schedule: %s, Time: %.4f sec\n",
-               n, num_threads, chunk_size, 
-               schedule_type == 0 ? "Static" : "Dynamic", execution_time);
+    return max_err;
+}
+
+void run_ooc_experiment(bench_context_t *ctx, const matfile_t *A, const matfile_t *B,
+                        int num_threads, double create_time) {
+    const config_t *config = ctx->config;
+    char c_path[sizeof(config->ooc_dir) + 16];
+    snprintf(c_path, sizeof(c_path), "%s/ooc_C.mat", config->ooc_dir);
+
+    thread_pool_t *pool = get_thread_pool(ctx, num_threads);
+    if (pool == NULL) {
+        fprintf(stderr, "Cannot start %d threads (max %d)\n", num_threads, MAX_THREADS);
+        return;
+    }
+
+    // Each trial writes a fresh C; only the last one is kept for checking
+    matfile_t *C = NULL;
+    double samples[HARNESS_MAX_TRIALS];
+    harness_counters_t counters = {0};
+    for (int trial = -ctx->harness.warmup; trial < ctx->harness.trials; trial++) {
+        matfile_close(C);
+        C = NULL;
+        harness_counters_start(&ctx->harness, trial);
+        double elapsed = ooc_multiply(ctx, pool, A, B, c_path, &C);
+        harness_counters_stop(&ctx->harness, trial, &counters);
+        if (elapsed < 0.0) return;
+        harness_sample(samples, trial, elapsed);
+    }
+
+    double flops = 2.0 * A->rows * (double)A->cols * B->cols;
+    char params[64];
+    snprintf(params, sizeof(params), "rows=%ld;inner=%ld;cols=%ld;tile=%d", A->rows, A->cols,
+             B->cols, A->tile);
+    harness_record_t record = {"gemm_ooc", "blocked", params, A->rows, num_threads, flops * 1e-9,
+                               "GFLOP/s", &counters};
+    harness_stats_t stats;
+    double execution_time = finish_trials(ctx, samples, ctx->harness.trials, &record, &stats);
+    double gflops = flops / execution_time * 1e-9;
+    double error = verify_ooc(A, B, C);
+    if (error > gemm_tolerance((int)A->cols)) {
+        fprintf(stderr, "WARNING: out-of-core result for %ldx%ld exceeds tolerance (%.2e > %.2e)\n",
+                C->rows, C->cols, error, gemm_tolerance((int)A->cols));
+    }
+
+    if (config->verbose) {
+        printf("Size: %ldx%ldx%ld, Tile: %d, Threads: %2d, Create: %.3f sec, Time: %.6f sec, "
+               "%.2f GFLOP/s, Error: %.1e\n", A->rows, A->cols, B->cols, A->tile, num_threads,
+               create_time, execution_time, gflops, error);
     } else {
-        printf("%d,%d,%d,%s,%.4f\n", n, num_threads, chunk_size,
-               schedule_type == 0 ? "static" : "dynamic", execution_time);
+        printf("%ld,%ld,%ld,%d,%d,%.6f,%.6f,%.2f,%.2e\n", A->rows, A->cols, B->cols, A->tile,
+               num_threads, create_time, execution_time, gflops, error);
     }
-    
-    free_matrix(A, n);
-    free_matrix(B, n);
-    free_matrix(C, n);
+
+    // Products of user-supplied inputs are kept; generated ones are scratch
+    matfile_close(C);
+    if (config->ooc_inputs[0] == '\0') unlink(c_path);
 }
 
 void print_usage(const char *program_name) {
@@ -173,14 +2866,43 @@ void print_usage(const char *program_name) {
     printf("  -s, --sizes SIZE1,SIZE2,...    Matrix sizes (comma-separated, default: 256,512,1024)\n");
     printf("  -t, --threads T1,T2,...        Thread counts (comma-separated, default: 1,2,4,8)\n");
     printf("  -c, --chunk C1,C2,...          Chunk sizes (comma-separated, default: 1,16,64)\n");
-    printf("  --schedule TYPE1,TYPE2         Schedule types: static,dynamic (default: static)\n");
+    printf("  --schedule TYPE1,TYPE2         Schedule types: static,dynamic,guided (default: static)\n");
+    printf("  -k, --kernel K1,K2             Kernels: naive,blocked,strassen (default: naive)\n");
+    printf("  --dtype T1,T2                  Element types: f64,f32,mixed,i16,i8 (default: f64)\n");
+    printf("                                 (non-f64 types use the i-k-j typed kernel)\n");
+    printf("  --strassen-cutoff N            Strassen recursion stops at N x N blocks (default: 256)\n");
+    printf("  --isa ISA                      Blocked microkernel: auto,avx512,avx2,sse2,scalar (default: auto)\n");
+    printf("  --prepared K                   Pack B once and multiply K (at most %d) different A's by it (blocked kernel)\n", HARNESS_MAX_TRIALS);
+    printf("  --batch N1,N2,...              Batched mode: many small NxN multiplies (e.g. 8,16,32,64)\n");
+    printf("  --batch-count COUNT            Matrices per batch (default: 4096)\n");
+    printf("  --sparse P1,P2                 Sparse mode: CSR SpMV/SpMM on uniform,banded,powerlaw patterns\n");
+    printf("  --density D                    Fraction of nonzeros in sparse mode (default: 0.01)\n");
+    printf("  --ooc N1,N2,...                Out-of-core mode: stream NxN operands from mmapped files\n");
+    printf("                                 (N may exceed %d; files go in --ooc-dir, default: .)\n", MAX_SIZE);
+    printf("  --ooc-input A.mat,B.mat        Out-of-core multiply of existing files, product in ooc_C.mat\n");
+    printf("  --tile T                       Out-of-core tile edge, a multiple of %d (default: 512)\n", MATFILE_TILE_ALIGN);
+    printf("  --seed S                       Seed for the operand data (default: %llu)\n", PRNG_DEFAULT_SEED);
+    printf("  --warmup N                     Untimed runs before each experiment's trials (default: %d)\n", HARNESS_DEFAULT_WARMUP);
+    printf("  --trials N                     Timed runs per experiment; times are medians (default: %d)\n", HARNESS_DEFAULT_TRIALS);
+    printf("  --output FILE                  Also write every experiment's statistics to FILE.csv or FILE.json\n");
+    printf("  --counters                     Add per-thread hardware counters (perf_event_open) to --output\n");
+    printf("  --retune                       Re-run blocked kernel tile tuning (cached in %s)\n", TILE_CACHE_FILE);
+    printf("  --placement MODE               none,compact,scatter or a CPU list like 0-7,16-23\n");
+    printf("                                 (pins threads and first-touches rows; default: none)\n");
+    printf("  --hugepages                    Back matrices with transparent huge pages\n");
     printf("  -a, --all                      Run comprehensive test (all combinations)\n");
     printf("  -v, --verbose                  Verbose output\n");
     printf("  -h, --help                     Show this help message\n\n");
     printf("Examples:\n");
     printf("  %s -s 512,1024 -t 4,8\n", program_name);
     printf("  %s --sizes 256,512,1024 --threads 2,4,8 --chunk 8,16\n", program_name);
+    printf("  %s -k naive,blocked -s 1024     # Compare the naive and blocked kernels\n", program_name);
+    printf("  %s --prepared 16 -s 1024        # Reuse one packed B across 16 multiplies\n", program_name);
+    printf("  %s --batch 8,16,32,64 -t 1,4,8  # Thousands of tiny GEMMs, parallel over the batch\n", program_name);
+    printf("  %s --sparse powerlaw -t 1,4,8   # Row- vs nonzero-balanced CSR partitioning\n", program_name);
+    printf("  %s --ooc 8192 --ooc-dir /scratch -t 8 # Operands streamed from disk\n", program_name);
     printf("  %s -a -v                        # Run all tests with verbose output\n", program_name);
+    printf("  %s -k blocked --trials 10 --output gemm.json # Timing statistics with host metadata\n", program_name);
 }
 
 void parse_comma_separated(const char *str, int *array, int *count) {
@@ -220,8 +2942,33 @@ void init_default_config(config_t *config) {
     config->schedule_types[0] = 0; // static
     config->num_schedule_types = 1;
     
+    // Default kernel
+    config->kernel_types[0] = 0; // naive
+    config->num_kernel_types = 1;
+    config->dtypes[0] = 0; // f64
+    config->num_dtypes = 1;
+    config->retune = 0;
+    config->strassen_cutoff = 256;
+    config->prepared_multiplies = 0;
+    config->num_batch_sizes = 0;
+    config->batch_count = 4096;
+    config->num_sparse_patterns = 0;
+    config->density = 0.01;
+    config->num_ooc_sizes = 0;
+    config->ooc_tile = 512;
+    strcpy(config->ooc_dir, ".");
+    config->ooc_inputs[0] = '\0';
+    config->seed = PRNG_DEFAULT_SEED;
+    config->warmup = HARNESS_DEFAULT_WARMUP;
+    config->trials = HARNESS_DEFAULT_TRIALS;
+    config->output[0] = '\0';
+    config->counters = 0;
+    strcpy(config->isa, "auto");
+    strcpy(config->placement, "none");
+    
     config->verbose = 0;
     config->test_all = 0;
+    config->huge_pages = 0;
 }
 
 int parse_arguments(int argc, char *argv[], config_t *config) {
@@ -232,6 +2979,27 @@ int parse_arguments(int argc, char *argv[], config_t *config) {
         {"threads", required_argument, 0, 't'},
         {"chunk", required_argument, 0, 'c'},
         {"schedule", required_argument, 0, 'd'}, // 'd' for schedule
+        {"kernel", required_argument, 0, 'k'},
+        {"dtype", required_argument, 0, 'T'},
+        {"retune", no_argument, 0, 'R'},
+        {"strassen-cutoff", required_argument, 0, 'S'},
+        {"prepared", required_argument, 0, 'p'},
+        {"batch", required_argument, 0, 'b'},
+        {"batch-count", required_argument, 0, 'B'},
+        {"sparse", required_argument, 0, 'X'},
+        {"density", required_argument, 0, 'D'},
+        {"ooc", required_argument, 0, 'O'},
+        {"ooc-input", required_argument, 0, 'F'},
+        {"ooc-dir", required_argument, 0, 'Y'},
+        {"tile", required_argument, 0, 'L'},
+        {"seed", required_argument, 0, 'E'},
+        {"warmup", required_argument, 0, 'W'},
+        {"trials", required_argument, 0, 'N'},
+        {"output", required_argument, 0, 'o'},
+        {"counters", no_argument, 0, 'Q'},
+        {"isa", required_argument, 0, 'I'},
+        {"placement", required_argument, 0, 'P'},
+        {"hugepages", no_argument, 0, 'H'},
         {"all", no_argument, 0, 'a'},
         {"verbose", no_argument, 0, 'v'},
         {"help", no_argument, 0, 'h'},
@@ -239,7 +3007,7 @@ int parse_arguments(int argc, char *argv[], config_t *config) {
     };
     
     int c;
-    while ((c = getopt_long(argc, argv, "s:t:c:avh", long_options, NULL)) != -1) {
+    while ((c = getopt_long(argc, argv, "s:t:c:k:avh", long_options, NULL)) != -1) {
         switch (c) {
             case 's':
                 parse_comma_separated(optarg, config->sizes, &config->num_sizes);
@@ -256,17 +3024,135 @@ int parse_arguments(int argc, char *argv[], config_t *config) {
                     char *token = strtok(copy, ",");
                     config->num_schedule_types = 0;
                     
-                    while (token != NULL && config->num_schedule_types < 2) {
-                        if (strcmp(token, "static") == 0) {
-                            config->schedule_types[config->num_schedule_types++] = 0;
-                        } else if (strcmp(token, "dynamic") == 0) {
-                            config->schedule_types[config->num_schedule_types++] = 1;
+                    while (token != NULL && config->num_schedule_types < NUM_SCHEDULES) {
+                        for (int k = 0; k < NUM_SCHEDULES; k++) {
+                            if (strcmp(token, schedule_names[k]) == 0) {
+                                config->schedule_types[config->num_schedule_types++] = k;
+                            }
+                        }
+                        token = strtok(NULL, ",");
+                    }
+                    free(copy);
+                }
+                break;
+            case 'k':
+                {
+                    char *copy = strdup(optarg);
+                    char *token = strtok(copy, ",");
+                    config->num_kernel_types = 0;
+                    
+                    while (token != NULL && config->num_kernel_types < NUM_KERNELS) {
+                        for (int k = 0; k < NUM_KERNELS; k++) {
+                            if (strcmp(token, kernel_names[k]) == 0) {
+                                config->kernel_types[config->num_kernel_types++] = k;
+                            }
+                        }
+                        token = strtok(NULL, ",");
+                    }
+                    free(copy);
+                    if (config->num_kernel_types == 0) return -1;
+                }
+                break;
+            case 'I':
+                snprintf(config->isa, sizeof(config->isa), "%s", optarg);
+                break;
+            case 'P':
+                snprintf(config->placement, sizeof(config->placement), "%s", optarg);
+                break;
+            case 'b':
+                parse_comma_separated(optarg, config->batch_sizes, &config->num_batch_sizes);
+                break;
+            case 'B':
+                config->batch_count = atoi(optarg);
+                if (config->batch_count < 1) return -1;
+                break;
+            case 'p':
+                config->prepared_multiplies = atoi(optarg);
+                // each multiply is one harness sample
+                if (config->prepared_multiplies < 1 ||
+                    config->prepared_multiplies > HARNESS_MAX_TRIALS) return -1;
+                break;
+            case 'S':
+                config->strassen_cutoff = atoi(optarg);
+                if (config->strassen_cutoff < 16) return -1;
+                break;
+            case 'T':
+                {
+                    char *copy = strdup(optarg);
+                    char *token = strtok(copy, ",");
+                    config->num_dtypes = 0;
+                    
+                    while (token != NULL && config->num_dtypes < 8) {
+                        for (int d = 0; d < NUM_DTYPES; d++) {
+                            if (strcmp(token, dtype_names[d]) == 0) {
+                                config->dtypes[config->num_dtypes++] = d;
+                            }
+                        }
+                        token = strtok(NULL, ",");
+                    }
+                    free(copy);
+                    if (config->num_dtypes == 0) return -1;
+                }
+                break;
+            case 'X':
+                {
+                    char *copy = strdup(optarg);
+                    char *token = strtok(copy, ",");
+                    config->num_sparse_patterns = 0;
+                    
+                    while (token != NULL && config->num_sparse_patterns < NUM_SPARSE_PATTERNS) {
+                        for (int p = 0; p < NUM_SPARSE_PATTERNS; p++) {
+                            if (strcmp(token, sparse_pattern_names[p]) == 0) {
+                                config->sparse_patterns[config->num_sparse_patterns++] = p;
+                            }
                         }
                         token = strtok(NULL, ",");
                     }
                     free(copy);
+                    if (config->num_sparse_patterns == 0) return -1;
                 }
                 break;
+            case 'D':
+                config->density = atof(optarg);
+                if (config->density <= 0.0 || config->density > 1.0) return -1;
+                break;
+            case 'O':
+                parse_comma_separated(optarg, config->ooc_sizes, &config->num_ooc_sizes);
+                break;
+            case 'F':
+                snprintf(config->ooc_inputs, sizeof(config->ooc_inputs), "%s", optarg);
+                if (strchr(config->ooc_inputs, ',') == NULL) return -1;
+                break;
+            case 'Y':
+                snprintf(config->ooc_dir, sizeof(config->ooc_dir), "%s", optarg);
+                break;
+            case 'L':
+                config->ooc_tile = atoi(optarg);
+                if (config->ooc_tile < MATFILE_TILE_ALIGN || config->ooc_tile % MATFILE_TILE_ALIGN != 0) return -1;
+                break;
+            case 'E':
+                config->seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'W':
+                config->warmup = atoi(optarg);
+                if (config->warmup < 0) return -1;
+                break;
+            case 'N':
+                config->trials = atoi(optarg);
+                if (config->trials < 1 || config->trials > HARNESS_MAX_TRIALS) return -1;
+                break;
+            case 'o':
+                snprintf(config->output, sizeof(config->output), "%s", optarg);
+                break;
+            case 'Q':
+                config->counters = 1;
+                break;
+            case 'R':
+                config->retune = 1;
+                break;
+            case 'H':
+                config->huge_pages = 1;
+                break;
             case 'a':
                 config->test_all = 1;
                 break;
@@ -283,7 +3169,8 @@ int parse_arguments(int argc, char *argv[], config_t *config) {
     return 0;
 }
 
-void run_comprehensive_test(config_t *config) {
+void run_comprehensive_test(bench_context_t *ctx) {
+    const config_t *config = ctx->config;
     if (config->verbose) {
         printf("=== Comprehensive Parallel Matrix Multiplication Test ===\n");
         printf("Matrix sizes: ");
@@ -298,13 +3185,21 @@ void run_comprehensive_test(config_t *config) {
         for (int i = 0; i < config->num_chunk_sizes; i++) {
             printf("%d ", config->chunk_sizes[i]);
         }
+        printf("\nKernels: ");
+        for (int i = 0; i < config->num_kernel_types; i++) {
+            printf("%s ", kernel_names[config->kernel_types[i]]);
+        }
+        printf("\nElement types: ");
+        for (int i = 0; i < config->num_dtypes; i++) {
+            printf("%s ", dtype_names[config->dtypes[i]]);
+        }
         printf("\nSchedule types: ");
         for (int i = 0; i < config->num_schedule_types; i++) {
-            printf("%s ", config->schedule_types[i] == 0 ? "static" : "dynamic");
+            printf("%s ", schedule_names[config->schedule_types[i]]);
         }
         printf("\n\n");
     } else {
-        printf("size,threads,chunk,schedule,time\n");
+        printf("size,dtype,kernel,threads,chunk,schedule,time,gflops,error,pool_startup\n");
     }
     
     for (int s = 0; s < config->num_sizes; s++) {
@@ -314,49 +3209,216 @@ void run_comprehensive_test(config_t *config) {
             printf("--- Matrix Size: %dx%d ---\n", size, size);
         }
         
-        for (int sch = 0; sch < config->num_schedule_types; sch++) {
-            int schedule_type = config->schedule_types[sch];
+        for (int d = 0; d < config->num_dtypes; d++) {
+            int dtype = config->dtypes[d];
+            int num_kernels = dtype == DTYPE_F64 ? config->num_kernel_types : 1;
             
-            if (config->verbose) {
-                printf("Schedule: %s\n", schedule_type == 0 ? "Static" : "Dynamic");
+            for (int k = 0; k < num_kernels; k++) {
+                int kernel_type = config->kernel_types[k];
+                
+                for (int sch = 0; sch < config->num_schedule_types; sch++) {
+                    int schedule_type = config->schedule_types[sch];
+                    
+                    if (config->verbose) {
+                        printf("Type: %s, Kernel: %s, Schedule: %s\n", dtype_names[dtype],
+                               dtype == DTYPE_F64 ? kernel_names[kernel_type] : "ikj",
+                               schedule_labels[schedule_type]);
+                    }
+                    
+                    for (int c = 0; c < config->num_chunk_sizes; c++) {
+                        int chunk = config->chunk_sizes[c];
+                        
+                        if (config->verbose) {
+                            printf("  Chunk Size: %d\n", chunk);
+                        }
+                        
+                        for (int t = 0; t < config->num_threads; t++) {
+                            int threads = config->threads[t];
+                            int same = dtype == DTYPE_F64 && kernel_type == 1
+                                ? repeated_blocked_chunk(config, size, threads, c, ctx->tiles) : -1;
+                            if (same >= 0) {
+                                if (config->verbose) {
+                                    printf("  Threads: %2d, same run as chunk %d, skipped\n",
+                                           threads, config->chunk_sizes[same]);
+                                }
+                                continue;
+                            }
+                            run_dtype_experiment(ctx, dtype, size, threads, chunk,
+                                                 schedule_type, kernel_type);
+                        }
+                        
+                        if (config->verbose) {
+                            printf("\n");
+                        }
+                    }
+                }
             }
+        }
+    }
+}
+
+void run_quick_test(bench_context_t *ctx) {
+    const config_t *config = ctx->config;
+    if (config->verbose) {
+        printf("=== Quick Parallel Matrix Multiplication Test ===\n");
+        printf("Testing basic configurations...\n\n");
+    } else {
+        printf("size,dtype,kernel,threads,chunk,schedule,time,gflops,error,pool_startup\n");
+    }
+    
+    for (int s = 0; s < config->num_sizes; s++) {
+        int size = config->sizes[s];
+        
+        // Test with default chunk size (16) and static scheduling
+        for (int d = 0; d < config->num_dtypes; d++) {
+            int dtype = config->dtypes[d];
+            int num_kernels = dtype == DTYPE_F64 ? config->num_kernel_types : 1;
             
+            for (int k = 0; k < num_kernels; k++) {
+                for (int t = 0; t < config->num_threads; t++) {
+                    int threads = config->threads[t];
+                    run_dtype_experiment(ctx, dtype, size, threads, 16, 0, config->kernel_types[k]);
+                }
+            }
+        }
+    }
+}
+
+void run_prepared_test(bench_context_t *ctx) {
+    const config_t *config = ctx->config;
+    if (config->verbose) {
+        printf("=== Prepared-B Matrix Multiplication Test (%d multiplies per B) ===\n\n",
+               config->prepared_multiplies);
+    } else {
+        printf("size,threads,chunk,schedule,multiplies,pack_time,time_per_multiply,gflops,amortized_gflops,error\n");
+    }
+    
+    for (int s = 0; s < config->num_sizes; s++) {
+        for (int sch = 0; sch < config->num_schedule_types; sch++) {
             for (int c = 0; c < config->num_chunk_sizes; c++) {
-                int chunk = config->chunk_sizes[c];
-                
-                if (config->verbose) {
-                    printf("  Chunk Size: %d\n", chunk);
+                for (int t = 0; t < config->num_threads; t++) {
+                    run_prepared_experiment(ctx, config->sizes[s], config->threads[t],
+                                            config->chunk_sizes[c], config->schedule_types[sch]);
                 }
-                
+            }
+        }
+    }
+}
+
+void run_batch_test(bench_context_t *ctx) {
+    const config_t *config = ctx->config;
+    if (config->verbose) {
+        printf("=== Batched Small-Matrix Multiplication Test (%d matrices per batch) ===\n\n",
+               config->batch_count);
+    } else {
+        printf("size,batch,kernel,threads,chunk,schedule,time,gflops,error\n");
+    }
+    
+    for (int s = 0; s < config->num_batch_sizes; s++) {
+        for (int sch = 0; sch < config->num_schedule_types; sch++) {
+            for (int c = 0; c < config->num_chunk_sizes; c++) {
                 for (int t = 0; t < config->num_threads; t++) {
-                    int threads = config->threads[t];
-                    run_experiment(size, threads, chunk, schedule_type, config->verbose);
+                    run_batch_experiment(ctx, config->batch_sizes[s], config->threads[t],
+                                         config->chunk_sizes[c], config->schedule_types[sch]);
+                }
+            }
+        }
+        if (config->verbose) {
+            printf("\n");
+        }
+    }
+}
+
+void run_sparse_test(bench_context_t *ctx) {
+    const config_t *config = ctx->config;
+    if (config->verbose) {
+        printf("=== Sparse (CSR) x Dense Test (density %.4f) ===\n\n", config->density);
+    } else {
+        printf("size,pattern,nnz,op,threads,chunk,schedule,time,gflops,imbalance,error\n");
+    }
+    
+    for (int s = 0; s < config->num_sizes; s++) {
+        for (int p = 0; p < config->num_sparse_patterns; p++) {
+            int pattern = config->sparse_patterns[p];
+            csr_matrix_t *S = generate_csr(pattern, config->sizes[s], config->density, config->seed);
+            if (S == NULL) {
+                fprintf(stderr, "Could not build the sparse matrix for size %d\n", config->sizes[s]);
+                continue;
+            }
+            
+            for (int op = SPARSE_SPMV; op <= SPARSE_SPMM; op++) {
+                // Row-count partitioning under every requested schedule ...
+                for (int sch = 0; sch < config->num_schedule_types; sch++) {
+                    for (int c = 0; c < config->num_chunk_sizes; c++) {
+                        for (int t = 0; t < config->num_threads; t++) {
+                            run_sparse_experiment(ctx, S, pattern, op, config->threads[t],
+                                                  config->chunk_sizes[c], config->schedule_types[sch], 0);
+                        }
+                    }
+                }
+                // ... against one nonzero-balanced range per thread
+                for (int t = 0; t < config->num_threads; t++) {
+                    run_sparse_experiment(ctx, S, pattern, op, config->threads[t], 0, 0, 1);
                 }
-                
                 if (config->verbose) {
                     printf("\n");
                 }
             }
+            free_csr(S);
         }
     }
 }
 
-void run_quick_test(config_t *config) {
+void run_ooc_test(bench_context_t *ctx) {
+    const config_t *config = ctx->config;
     if (config->verbose) {
-        printf("=== Quick Parallel Matrix Multiplication Test ===\n");
-        printf("Testing basic configurations...\n\n");
+        printf("=== Out-of-Core Matrix Multiplication Test (tile %d, files in %s) ===\n\n",
+               config->ooc_tile, config->ooc_dir);
     } else {
-        printf("size,threads,chunk,schedule,time\n");
+        printf("rows,inner,cols,tile,threads,create_time,time,gflops,error\n");
     }
     
-    for (int s = 0; s < config->num_sizes; s++) {
-        int size = config->sizes[s];
-        
-        // Test with default chunk size (16) and static scheduling
-        for (int t = 0; t < config->num_threads; t++) {
-            int threads = config->threads[t];
-            run_experiment(size, threads, 16, 0, config->verbose);
+    if (config->ooc_inputs[0] != '\0') {
+        char paths[sizeof(config->ooc_inputs)];
+        snprintf(paths, sizeof(paths), "%s", config->ooc_inputs);
+        char *comma = strchr(paths, ',');
+        *comma = '\0';
+        matfile_t *A = matfile_open(paths, 0);
+        matfile_t *B = matfile_open(comma + 1, 0);
+        if (A != NULL && B != NULL) {
+            for (int t = 0; t < config->num_threads; t++) {
+                run_ooc_experiment(ctx, A, B, config->threads[t], 0.0);
+            }
+        }
+        matfile_close(A);
+        matfile_close(B);
+        return;
+    }
+    
+    char a_path[sizeof(config->ooc_dir) + 16], b_path[sizeof(config->ooc_dir) + 16];
+    snprintf(a_path, sizeof(a_path), "%s/ooc_A.mat", config->ooc_dir);
+    snprintf(b_path, sizeof(b_path), "%s/ooc_B.mat", config->ooc_dir);
+    
+    for (int s = 0; s < config->num_ooc_sizes; s++) {
+        int n = config->ooc_sizes[s];
+        double start_time = harness_now();
+        matfile_t *A = matfile_create(a_path, n, n, config->ooc_tile, DTYPE_F64);
+        matfile_t *B = matfile_create(b_path, n, n, config->ooc_tile, DTYPE_F64);
+        if (A != NULL && B != NULL) {
+            matfile_fill_random(A, config->seed, STREAM_A);
+            matfile_fill_random(B, config->seed, STREAM_B);
+            msync(A->base, A->bytes, MS_SYNC);
+            msync(B->base, B->bytes, MS_SYNC);
+            double create_time = harness_now() - start_time;
+            
+            for (int t = 0; t < config->num_threads; t++) {
+                run_ooc_experiment(ctx, A, B, config->threads[t], create_time);
+            }
         }
+        matfile_close(A);
+        matfile_close(B);
+        unlink(a_path);
+        unlink(b_path);
     }
 }
 
@@ -368,11 +3430,68 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
-    if (config.test_all) {
-        run_comprehensive_test(&config);
+    const microkernel_t *ukr = select_microkernel(config.isa);
+    if (ukr == NULL) {
+        fprintf(stderr, "Microkernel '%s' is unknown or not supported by this CPU.\n", config.isa);
+        return 1;
+    }
+    if (!self_test_microkernel(ukr)) {
+        fprintf(stderr, "WARNING: %s microkernel failed its self-test, using scalar\n", ukr->name);
+        ukr = select_microkernel("scalar");
+    }
+    if (config.verbose) {
+        printf("Blocked microkernel: %s (%dx%d)\n", ukr->name, ukr->mr, ukr->nr);
+    }
+    
+    gemm_tiles_t tiles;
+    default_tiles(&tiles, ukr);
+    for (int k = 0; k < config.num_kernel_types; k++) {
+        if (config.kernel_types[k] != 0 || config.prepared_multiplies > 0 ||
+            config.num_ooc_sizes > 0 || config.ooc_inputs[0] != '\0') {
+            setup_tiles(&tiles, ukr, config.retune, config.verbose);
+            break;
+        }
+    }
+    
+    bench_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.config = &config;
+    ctx.tiles = &tiles;
+    harness_init(&ctx.harness, "matrix_mult");
+    ctx.harness.warmup = config.warmup;
+    ctx.harness.trials = config.trials;
+    ctx.harness.output = config.output[0] != '\0' ? config.output : NULL;
+    ctx.harness.counters = config.counters;
+    if (harness_open(&ctx.harness) != 0) {
+        fprintf(stderr, "Cannot write '%s' (use a .csv or .json file).\n", config.output);
+        return 1;
+    }
+    if (placement_init(&ctx.placement, config.placement) != 0) {
+        fprintf(stderr, "Invalid placement '%s'.\n", config.placement);
+        return 1;
+    }
+    if (config.verbose && ctx.placement.mode != PLACEMENT_NONE) {
+        printf("Placement: %s over %d CPUs on %d NUMA node(s)\n",
+               placement_mode_name(ctx.placement.mode), ctx.placement.num_cpus,
+               ctx.placement.num_nodes);
+    }
+    
+    if (config.num_ooc_sizes > 0 || config.ooc_inputs[0] != '\0') {
+        run_ooc_test(&ctx);
+    } else if (config.num_sparse_patterns > 0) {
+        run_sparse_test(&ctx);
+    } else if (config.num_batch_sizes > 0) {
+        run_batch_test(&ctx);
+    } else if (config.prepared_multiplies > 0) {
+        run_prepared_test(&ctx);
+    } else if (config.test_all) {
+        run_comprehensive_test(&ctx);
     } else {
-        run_quick_test(&config);
+        run_quick_test(&ctx);
     }
     
+    destroy_thread_pools(&ctx);
+    harness_close(&ctx.harness);
+    
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,247 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+// NUMA-aware thread and memory placement shared by the labs.
+//
+// Topology comes from sysfs (/sys/devices/system/node), so no libnuma is
+// needed at build time. On single-node machines, or when sysfs is hidden
+// inside a container, every CPU is reported on node 0 and pinning still
+// works through the process affinity mask.
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sched.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#define PLACEMENT_MAX_CPUS 1024
+#define PLACEMENT_MAX_NODES 64
+#define PLACEMENT_PAGE_SAMPLES 4096
+
+typedef enum {
+    PLACEMENT_NONE = 0,    // OS decides, no pinning or first-touch pass
+    PLACEMENT_COMPACT,     // fill one node before moving to the next
+    PLACEMENT_SCATTER,     // round-robin threads across nodes
+    PLACEMENT_LIST         // explicit CPU list, thread i -> cpus[i % n]
+} placement_mode_t;
+
+typedef struct {
+    placement_mode_t mode;
+    int num_cpus;                        // CPUs in thread order
+    int cpus[PLACEMENT_MAX_CPUS];
+    int num_nodes;
+    int cpu_node[PLACEMENT_MAX_CPUS];    // cpu id -> node id
+} placement_t;
+
+static inline const char *placement_mode_name(placement_mode_t mode) {
+    static const char *names[] = {"none", "compact", "scatter", "list"};
+    return names[mode];
+}
+
+// Parse "0-3,8,10-11" into cpus[]; returns the number of CPUs read
+static inline int placement_parse_cpulist(const char *str, int *cpus, int max_cpus) {
+    int count = 0;
+    const char *p = str;
+
+    while (*p != '\0' && *p != '\n') {
+        if (!isdigit((unsigned char)*p)) {
+            p++;
+            continue;
+        }
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (*end == '-') {
+            last = strtol(end + 1, &end, 10);
+        }
+        for (long cpu = first; cpu <= last && count < max_cpus; cpu++) {
+            if (cpu >= 0 && cpu < PLACEMENT_MAX_CPUS) cpus[count++] = (int)cpu;
+        }
+        p = end;
+    }
+    return count;
+}
+
+// Read node membership from sysfs; CPUs not listed anywhere stay on node 0
+static inline void placement_read_topology(placement_t *p) {
+    int node_cpus[PLACEMENT_MAX_CPUS];
+    char path[96], line[4096];
+
+    memset(p->cpu_node, 0, sizeof(p->cpu_node));
+    p->num_nodes = 1;
+
+    for (int node = 0; node < PLACEMENT_MAX_NODES; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL) continue;
+        if (fgets(line, sizeof(line), fp) != NULL) {
+            int count = placement_parse_cpulist(line, node_cpus, PLACEMENT_MAX_CPUS);
+            for (int i = 0; i < count; i++) {
+                p->cpu_node[node_cpus[i]] = node;
+            }
+            if (count > 0 && node + 1 > p->num_nodes) p->num_nodes = node + 1;
+        }
+        fclose(fp);
+    }
+}
+
+// CPUs this process may run on (honours taskset and cgroup cpusets)
+static inline int placement_allowed_cpus(int *cpus) {
+    cpu_set_t set;
+    int count = 0;
+
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int cpu = 0; cpu < online && cpu < PLACEMENT_MAX_CPUS; cpu++) {
+            cpus[count++] = cpu;
+        }
+        return count;
+    }
+    for (int cpu = 0; cpu < PLACEMENT_MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) cpus[count++] = cpu;
+    }
+    return count;
+}
+
+// Build a placement from "none", "compact", "scatter" or an explicit CPU
+// list such as "0-7,16-23". Returns -1 if the specification is invalid.
+static inline int placement_init(placement_t *p, const char *spec) {
+    int allowed[PLACEMENT_MAX_CPUS];
+    int num_allowed = placement_allowed_cpus(allowed);
+
+    memset(p, 0, sizeof(*p));
+    placement_read_topology(p);
+
+    if (spec == NULL || strcmp(spec, "none") == 0) {
+        p->mode = PLACEMENT_NONE;
+        memcpy(p->cpus, allowed, num_allowed * sizeof(int));
+        p->num_cpus = num_allowed;
+    } else if (strcmp(spec, "compact") == 0) {
+        p->mode = PLACEMENT_COMPACT;
+        for (int node = 0; node < p->num_nodes; node++) {
+            for (int i = 0; i < num_allowed; i++) {
+                if (p->cpu_node[allowed[i]] == node) p->cpus[p->num_cpus++] = allowed[i];
+            }
+        }
+    } else if (strcmp(spec, "scatter") == 0) {
+        // Take the k-th CPU of every node in turn
+        p->mode = PLACEMENT_SCATTER;
+        int taken[PLACEMENT_MAX_CPUS] = {0};
+        while (p->num_cpus < num_allowed) {
+            for (int node = 0; node < p->num_nodes; node++) {
+                for (int i = 0; i < num_allowed; i++) {
+                    if (!taken[i] && p->cpu_node[allowed[i]] == node) {
+                        taken[i] = 1;
+                        p->cpus[p->num_cpus++] = allowed[i];
+                        break;
+                    }
+                }
+            }
+        }
+    } else {
+        p->mode = PLACEMENT_LIST;
+        if (!isdigit((unsigned char)spec[0])) return -1;
+        p->num_cpus = placement_parse_cpulist(spec, p->cpus, PLACEMENT_MAX_CPUS);
+    }
+    return p->num_cpus > 0 ? 0 : -1;
+}
+
+static inline int placement_cpu(const placement_t *p, int thread_id) {
+    return p->cpus[thread_id % p->num_cpus];
+}
+
+static inline int placement_node(const placement_t *p, int thread_id) {
+    return p->cpu_node[placement_cpu(p, thread_id)];
+}
+
+// Pin the calling thread to its CPU; a no-op for PLACEMENT_NONE
+static inline int placement_pin_self(const placement_t *p, int thread_id) {
+    if (p->mode == PLACEMENT_NONE) return 0;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(placement_cpu(p, thread_id), &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// Count which node the pages of [addr, addr + bytes) live on, sampling at
+// most PLACEMENT_PAGE_SAMPLES pages. Returns -1 if the kernel refuses the
+// query (no NUMA support, or move_pages blocked by a seccomp profile).
+static inline int placement_page_nodes(const void *addr, size_t bytes, long *pages_per_node) {
+    long page = sysconf(_SC_PAGESIZE);
+    size_t num_pages = (bytes + page - 1) / page;
+    size_t samples = num_pages < PLACEMENT_PAGE_SAMPLES ? num_pages : PLACEMENT_PAGE_SAMPLES;
+    void *pages[PLACEMENT_PAGE_SAMPLES];
+    int status[PLACEMENT_PAGE_SAMPLES];
+
+    memset(pages_per_node, 0, PLACEMENT_MAX_NODES * sizeof(long));
+    if (samples == 0) return 0;
+
+#ifdef SYS_move_pages
+    uintptr_t base = (uintptr_t)addr & ~(uintptr_t)(page - 1);
+    for (size_t i = 0; i < samples; i++) {
+        pages[i] = (void *)(base + (i * num_pages / samples) * page);
+    }
+    if (syscall(SYS_move_pages, 0, samples, pages, NULL, status, 0) != 0) return -1;
+    for (size_t i = 0; i < samples; i++) {
+        if (status[i] >= 0 && status[i] < PLACEMENT_MAX_NODES) pages_per_node[status[i]]++;
+    }
+    return 0;
+#else
+    (void)addr;
+    (void)pages;
+    (void)status;
+    return -1;
+#endif
+}
+
+static inline void placement_print_pages(const placement_t *p, const char *label,
+                                         const void *addr, size_t bytes) {
+    long pages_per_node[PLACEMENT_MAX_NODES];
+
+    printf("%s pages by node:", label);
+    if (placement_page_nodes(addr, bytes, pages_per_node) != 0) {
+        printf(" unavailable\n");
+        return;
+    }
+    long total = 0;
+    for (int node = 0; node < p->num_nodes; node++) total += pages_per_node[node];
+    for (int node = 0; node < p->num_nodes; node++) {
+        printf(" node%d=%.0f%%", node, total > 0 ? 100.0 * pages_per_node[node] / total : 0.0);
+    }
+    printf("\n");
+}
+
+// Aggregate per-thread traffic into per-node bandwidth: bytes add up, and
+// the node is done when its slowest thread is
+static inline void placement_print_bandwidth(const placement_t *p, const char *label,
+                                             int num_threads, const double *thread_bytes,
+                                             const double *thread_seconds) {
+    double bytes[PLACEMENT_MAX_NODES] = {0.0};
+    double seconds[PLACEMENT_MAX_NODES] = {0.0};
+    int threads[PLACEMENT_MAX_NODES] = {0};
+
+    for (int t = 0; t < num_threads; t++) {
+        int node = p->mode == PLACEMENT_NONE ? 0 : placement_node(p, t);
+        bytes[node] += thread_bytes[t];
+        if (thread_seconds[t] > seconds[node]) seconds[node] = thread_seconds[t];
+        threads[node]++;
+    }
+
+    printf("%s bandwidth (%s placement):\n", label, placement_mode_name(p->mode));
+    for (int node = 0; node < p->num_nodes; node++) {
+        if (threads[node] == 0) continue;
+        printf("  node %d: %2d threads, %8.2f GB/s\n", node, threads[node],
+               seconds[node] > 0.0 ? bytes[node] / seconds[node] * 1e-9 : 0.0);
+    }
+}
+
+#endif // PLACEMENT_H
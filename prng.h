@@ -0,0 +1,90 @@
+#ifndef PRNG_H
+#define PRNG_H
+
+// Counter-based random numbers shared by the labs (Philox4x32-10, Salmon et
+// al., SC'11).
+//
+// Element i of stream s under seed k is a pure function of (k, s, i), so any
+// thread can fill any slice of an array without shared state and the data is
+// bitwise identical for every thread count and partitioning. One Philox
+// block yields 128 bits, which become two doubles with 52 random bits each.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PRNG_DEFAULT_SEED 20240229ULL
+#define PRNG_FILL_BLOCK 4096 // elements per parallel work item in the fills
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+// One 128-bit block for counter (index, stream, 0). Straight-line 32-bit
+// multiplies only, so loops over consecutive blocks vectorise.
+static inline void philox4x32(uint64_t index, uint32_t stream, uint64_t seed, uint32_t out[4]) {
+    uint32_t c0 = (uint32_t)index, c1 = (uint32_t)(index >> 32), c2 = stream, c3 = 0;
+    uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+
+    for (int round = 0; round < 10; round++) {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t)p1;
+        c3 = (uint32_t)p0;
+        c0 = n0;
+        c2 = n2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// Top 52 bits as the mantissa of a double in [1, 2), minus one. Unlike an
+// integer-to-double conversion this is plain bit arithmetic in SSE2/AVX2.
+static inline double prng_to_unit(uint32_t hi, uint32_t lo) {
+    uint64_t bits = 0x3FF0000000000000ULL | ((((uint64_t)hi << 32) | lo) >> 12);
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d - 1.0;
+}
+
+// Element index of a stream as a double in [0, 1)
+static inline double prng_uniform(uint64_t seed, uint32_t stream, uint64_t index) {
+    uint32_t r[4];
+    philox4x32(index >> 1, stream, seed, r);
+    return index & 1 ? prng_to_unit(r[2], r[3]) : prng_to_unit(r[0], r[1]);
+}
+
+// dst[0 .. count) = elements [first, first + count) of the stream, scaled to
+// [lo, hi). The body runs on whole blocks so the compiler can vectorise it;
+// an unaligned first or last element goes through prng_uniform.
+static inline void prng_fill_uniform(double *dst, size_t count, uint64_t seed, uint32_t stream,
+                                     uint64_t first, double lo, double hi) {
+    double scale = hi - lo;
+    size_t done = 0;
+
+    if (count > 0 && (first & 1)) {
+        dst[done++] = lo + scale * prng_uniform(seed, stream, first);
+    }
+    size_t pairs = (count - done) / 2;
+    uint64_t block = (first + done) >> 1;
+    double *out = dst + done;
+    for (size_t p = 0; p < pairs; p++) {
+        uint32_t r[4];
+        philox4x32(block + p, stream, seed, r);
+        out[2 * p] = lo + scale * prng_to_unit(r[0], r[1]);
+        out[2 * p + 1] = lo + scale * prng_to_unit(r[2], r[3]);
+    }
+    done += 2 * pairs;
+    if (done < count) {
+        dst[done] = lo + scale * prng_uniform(seed, stream, first + done);
+    }
+}
+
+#endif // PRNG_H
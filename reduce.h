@@ -0,0 +1,241 @@
+#ifndef REDUCE_H
+#define REDUCE_H
+
+// Generic OpenMP reductions shared by the labs.
+//
+// Every operation picks the combining strategy that suits its accumulator:
+//   - sum, min, max:     built-in reduction clauses (with simd), the runtime
+//                        merges scalars cheaper than anything hand-written
+//   - argmin, argmax:    declare-reduction over a (value, index) pair
+//   - mean / variance:   per-thread accumulators in cache-line padded slots,
+//                        merged by a log-depth tree (Chan et al.'s update)
+//   - histogram:         per-thread padded bucket arrays, merged bucket by
+//                        bucket in parallel, so no lock or atomic is taken
+// REDUCE_DEFINE builds the padded-slot/tree version for any other
+// associative operator and element type.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#define REDUCE_CACHE_LINE 64
+
+#define REDUCE_BLOCK 2048 // elements handed to ACCUMULATE at a time
+
+// Each thread folds its static share into a private accumulator one block
+// at a time, then the slots are merged by a tree that pairs slot t with
+// slot t + stride. The merge order depends on the team size only.
+//
+//   ACC_T  INIT                     identity value
+//   void   ACCUMULATE(ACC_T *, const ELEM_T *block, long long first, long long count)
+//   ACC_T  COMBINE(ACC_T left, ACC_T right)    (associative)
+#define REDUCE_DEFINE(NAME, ELEM_T, ACC_T, INIT, ACCUMULATE, COMBINE)                    \
+typedef struct {                                                                         \
+    _Alignas(REDUCE_CACHE_LINE) ACC_T value;                                             \
+} NAME##_slot_t;                                                                         \
+                                                                                         \
+static inline ACC_T NAME(const ELEM_T *a, long long n) {                                 \
+    int max_threads = omp_get_max_threads();                                             \
+    NAME##_slot_t *slots = (NAME##_slot_t *)aligned_alloc(                               \
+        REDUCE_CACHE_LINE, max_threads * sizeof(NAME##_slot_t));                         \
+    ACC_T result = INIT;                                                                 \
+    if (slots == NULL) return result;                                                    \
+                                                                                         \
+    _Pragma("omp parallel")                                                              \
+    {                                                                                    \
+        int num_threads = omp_get_num_threads();                                         \
+        int thread_id = omp_get_thread_num();                                            \
+        ACC_T acc = INIT;                                                                \
+        _Pragma("omp for schedule(static) nowait")                                       \
+        for (long long b = 0; b < n; b += REDUCE_BLOCK) {                                \
+            ACCUMULATE(&acc, a + b, b, n - b < REDUCE_BLOCK ? n - b : REDUCE_BLOCK);     \
+        }                                                                                \
+        slots[thread_id].value = acc;                                                    \
+        for (int stride = 1; stride < num_threads; stride *= 2) {                        \
+            _Pragma("omp barrier")                                                       \
+            if (thread_id % (2 * stride) == 0 && thread_id + stride < num_threads) {     \
+                slots[thread_id].value = COMBINE(slots[thread_id].value,                 \
+                                                 slots[thread_id + stride].value);       \
+            }                                                                            \
+        }                                                                                \
+    }                                                                                    \
+    result = slots[0].value;                                                             \
+    free(slots);                                                                         \
+    return result;                                                                       \
+}
+
+// ---------------------------------------------------------------------------
+// Sum, min, max
+// ---------------------------------------------------------------------------
+
+#define REDUCE_PRAGMA(x) _Pragma(#x)
+
+#define REDUCE_DEFINE_BUILTIN(NAME, ELEM_T, OP, APPLY, INIT)                             \
+static inline ELEM_T NAME(const ELEM_T *a, long long n) {                                \
+    ELEM_T result = INIT;                                                                \
+    REDUCE_PRAGMA(omp parallel for simd schedule(static) reduction(OP:result))           \
+    for (long long i = 0; i < n; i++) {                                                  \
+        result = APPLY(result, a[i]);                                                    \
+    }                                                                                    \
+    return result;                                                                       \
+}
+
+#define REDUCE_APPLY_SUM(acc, x) ((acc) + (x))
+#define REDUCE_APPLY_MIN(acc, x) ((x) < (acc) ? (x) : (acc))
+#define REDUCE_APPLY_MAX(acc, x) ((x) > (acc) ? (x) : (acc))
+
+REDUCE_DEFINE_BUILTIN(reduce_sum_f64, double, +, REDUCE_APPLY_SUM, 0.0)
+REDUCE_DEFINE_BUILTIN(reduce_sum_i64, int64_t, +, REDUCE_APPLY_SUM, 0)
+REDUCE_DEFINE_BUILTIN(reduce_min_f64, double, min, REDUCE_APPLY_MIN, INFINITY)
+REDUCE_DEFINE_BUILTIN(reduce_max_f64, double, max, REDUCE_APPLY_MAX, -INFINITY)
+REDUCE_DEFINE_BUILTIN(reduce_min_i64, int64_t, min, REDUCE_APPLY_MIN, INT64_MAX)
+REDUCE_DEFINE_BUILTIN(reduce_max_i64, int64_t, max, REDUCE_APPLY_MAX, INT64_MIN)
+
+// ---------------------------------------------------------------------------
+// argmin, argmax: ties go to the smallest index, so the answer is unique
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    double value;
+    long long index; // -1 for an empty input
+} reduce_arg_t;
+
+static inline reduce_arg_t reduce_argmin_merge(reduce_arg_t a, reduce_arg_t b) {
+    if (b.index < 0) return a;
+    if (a.index < 0 || b.value < a.value || (b.value == a.value && b.index < a.index)) return b;
+    return a;
+}
+
+static inline reduce_arg_t reduce_argmax_merge(reduce_arg_t a, reduce_arg_t b) {
+    if (b.index < 0) return a;
+    if (a.index < 0 || b.value > a.value || (b.value == a.value && b.index < a.index)) return b;
+    return a;
+}
+
+#pragma omp declare reduction(argmin_f64 : reduce_arg_t : omp_out = reduce_argmin_merge(omp_out, omp_in)) \
+    initializer(omp_priv = (reduce_arg_t){INFINITY, -1})
+#pragma omp declare reduction(argmax_f64 : reduce_arg_t : omp_out = reduce_argmax_merge(omp_out, omp_in)) \
+    initializer(omp_priv = (reduce_arg_t){-INFINITY, -1})
+
+static inline reduce_arg_t reduce_argmin_f64(const double *a, long long n) {
+    reduce_arg_t result = {INFINITY, -1};
+    #pragma omp parallel for schedule(static) reduction(argmin_f64:result)
+    for (long long i = 0; i < n; i++) {
+        if (result.index < 0 || a[i] < result.value) {
+            result.value = a[i];
+            result.index = i;
+        }
+    }
+    return result;
+}
+
+static inline reduce_arg_t reduce_argmax_f64(const double *a, long long n) {
+    reduce_arg_t result = {-INFINITY, -1};
+    #pragma omp parallel for schedule(static) reduction(argmax_f64:result)
+    for (long long i = 0; i < n; i++) {
+        if (result.index < 0 || a[i] > result.value) {
+            result.value = a[i];
+            result.index = i;
+        }
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Mean and variance (Welford / Chan et al.)
+//
+// A per-element Welford update divides for every element. Instead each
+// block gets an exact two-pass mean and M2 while it sits in L1, and blocks,
+// threads and slots are all merged with the same pairwise update.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    long long count;
+    double mean;
+    double m2; // sum of squared deviations from the mean
+} reduce_moments_t;
+
+static inline reduce_moments_t reduce_moments_merge(reduce_moments_t a, reduce_moments_t b);
+
+static inline void reduce_moments_add(reduce_moments_t *acc, const double *x,
+                                      long long first, long long count) {
+    double sum = 0.0, m2 = 0.0;
+    (void)first;
+    #pragma omp simd reduction(+:sum)
+    for (long long i = 0; i < count; i++) sum += x[i];
+    double mean = sum / count;
+    #pragma omp simd reduction(+:m2)
+    for (long long i = 0; i < count; i++) m2 += (x[i] - mean) * (x[i] - mean);
+    reduce_moments_t block = {count, mean, m2};
+    *acc = reduce_moments_merge(*acc, block);
+}
+
+static inline reduce_moments_t reduce_moments_merge(reduce_moments_t a, reduce_moments_t b) {
+    if (a.count == 0) return b;
+    if (b.count == 0) return a;
+    reduce_moments_t r;
+    r.count = a.count + b.count;
+    double delta = b.mean - a.mean;
+    r.mean = a.mean + delta * ((double)b.count / r.count);
+    r.m2 = a.m2 + b.m2 + delta * delta * ((double)a.count * b.count / r.count);
+    return r;
+}
+
+REDUCE_DEFINE(reduce_moments_f64, double, reduce_moments_t, ((reduce_moments_t){0, 0.0, 0.0}),
+              reduce_moments_add, reduce_moments_merge)
+
+// Sample variance (n - 1 denominator); 0 for fewer than two elements
+static inline double reduce_variance(reduce_moments_t m) {
+    return m.count > 1 ? m.m2 / (m.count - 1) : 0.0;
+}
+
+// ---------------------------------------------------------------------------
+// Histogram over [lo, hi) in equal-width buckets. Values below lo land in
+// bucket 0 and values at or above hi in the last bucket.
+// ---------------------------------------------------------------------------
+
+static inline int reduce_bucket(double x, double lo, double scale, int buckets) {
+    double pos = (x - lo) * scale;
+    if (!(pos >= 0.0)) return 0; // also catches NaN
+    if (pos >= buckets) return buckets - 1;
+    return (int)pos;
+}
+
+// counts[0 .. buckets) receives the totals. Returns -1 if scratch space
+// for the per-thread copies cannot be allocated.
+static inline int reduce_histogram_f64(const double *a, long long n, double lo, double hi,
+                                       int buckets, long long *counts) {
+    int max_threads = omp_get_max_threads();
+    int per_line = REDUCE_CACHE_LINE / sizeof(long long);
+    long long stride = (buckets + per_line - 1) / per_line * per_line; // pad each copy
+    long long *local = (long long *)aligned_alloc(REDUCE_CACHE_LINE,
+                                                  max_threads * stride * sizeof(long long));
+    double scale = buckets / (hi - lo);
+    if (local == NULL) return -1;
+
+    #pragma omp parallel
+    {
+        int num_threads = omp_get_num_threads();
+        long long *mine = local + omp_get_thread_num() * stride;
+        memset(mine, 0, stride * sizeof(long long));
+
+        #pragma omp for schedule(static)
+        for (long long i = 0; i < n; i++) {
+            mine[reduce_bucket(a[i], lo, scale, buckets)]++;
+        }
+
+        // Implicit barrier above; now each thread owns a range of buckets
+        #pragma omp for schedule(static)
+        for (int b = 0; b < buckets; b++) {
+            long long total = 0;
+            for (int t = 0; t < num_threads; t++) total += local[t * stride + b];
+            counts[b] = total;
+        }
+    }
+    free(local);
+    return 0;
+}
+
+#endif // REDUCE_H
@@ -0,0 +1,156 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+// Parallel prefix sums (scans) shared by the labs.
+//
+// Two algorithms, each for double and int64_t, inclusive or exclusive:
+//
+//   scan_*            Blocked three-phase: every thread sums its static
+//                     block, one thread scans the block totals, then every
+//                     thread rescans its block from its offset. Two passes
+//                     over the data; out may equal in.
+//
+//   scan_lookback_*   Single pass with decoupled look-back (Merrill and
+//                     Garland, 2016). Tiles are claimed in order from an
+//                     atomic ticket; each tile publishes its total, then
+//                     walks back over its predecessors' published totals
+//                     until it meets a full prefix. A tile is read twice
+//                     while it is still in cache, so memory sees one read
+//                     and one write per element. out may equal in.
+//
+// Exclusive scans write the identity (0) first and leave the grand total
+// out of the array.
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#define SCAN_TILE 16384 // elements per look-back tile (128 KB of double)
+
+enum { SCAN_INCLUSIVE = 0, SCAN_EXCLUSIVE = 1 };
+
+// Tile status in the look-back: nothing yet, own total, or full prefix
+enum { SCAN_EMPTY = 0, SCAN_AGGREGATE = 1, SCAN_PREFIX = 2 };
+
+#define DEFINE_SCAN(SUFFIX, T)                                                           \
+                                                                                         \
+/* Scan in[0 .. n) into out starting from carry; returns carry + total */               \
+static inline T scan_serial_##SUFFIX(const T *in, T *out, long long n, T carry,          \
+                                     int exclusive) {                                    \
+    if (exclusive) {                                                                     \
+        for (long long i = 0; i < n; i++) {                                              \
+            T x = in[i];                                                                 \
+            out[i] = carry;                                                              \
+            carry += x;                                                                  \
+        }                                                                                \
+    } else {                                                                             \
+        for (long long i = 0; i < n; i++) {                                              \
+            carry += in[i];                                                              \
+            out[i] = carry;                                                              \
+        }                                                                                \
+    }                                                                                    \
+    return carry;                                                                        \
+}                                                                                        \
+                                                                                         \
+static inline void scan_##SUFFIX(const T *in, T *out, long long n, int exclusive) {      \
+    int max_threads = omp_get_max_threads();                                             \
+    T *offsets = (T *)malloc((max_threads + 1) * sizeof(T));                             \
+    if (offsets == NULL) {                                                               \
+        scan_serial_##SUFFIX(in, out, n, 0, exclusive);                                  \
+        return;                                                                          \
+    }                                                                                    \
+                                                                                         \
+    _Pragma("omp parallel")                                                              \
+    {                                                                                    \
+        int num_threads = omp_get_num_threads();                                         \
+        int thread_id = omp_get_thread_num();                                            \
+        long long begin = n * thread_id / num_threads;                                   \
+        long long end = n * (thread_id + 1) / num_threads;                               \
+                                                                                         \
+        /* Phase 1: block totals */                                                      \
+        T total = 0;                                                                     \
+        _Pragma("omp simd reduction(+:total)")                                           \
+        for (long long i = begin; i < end; i++) total += in[i];                          \
+        offsets[thread_id + 1] = total;                                                  \
+        _Pragma("omp barrier")                                                           \
+                                                                                         \
+        /* Phase 2: exclusive scan of the totals */                                      \
+        _Pragma("omp single")                                                            \
+        {                                                                                \
+            offsets[0] = 0;                                                              \
+            for (int t = 1; t <= num_threads; t++) offsets[t] += offsets[t - 1];         \
+        }                                                                                \
+                                                                                         \
+        /* Phase 3: rescan each block from its offset */                                 \
+        scan_serial_##SUFFIX(in + begin, out + begin, end - begin,                       \
+                             offsets[thread_id], exclusive);                             \
+    }                                                                                    \
+    free(offsets);                                                                       \
+}                                                                                        \
+                                                                                         \
+typedef struct {                                                                         \
+    atomic_int status;                                                                   \
+    T aggregate;      /* valid once status >= SCAN_AGGREGATE */                          \
+    T prefix;         /* inclusive prefix, valid once status == SCAN_PREFIX */           \
+} scan_tile_##SUFFIX##_t;                                                                \
+                                                                                         \
+static inline void scan_lookback_##SUFFIX(const T *in, T *out, long long n,              \
+                                          int exclusive) {                               \
+    long long num_tiles = (n + SCAN_TILE - 1) / SCAN_TILE;                               \
+    scan_tile_##SUFFIX##_t *tiles = (scan_tile_##SUFFIX##_t *)calloc(                    \
+        num_tiles > 0 ? num_tiles : 1, sizeof(scan_tile_##SUFFIX##_t));                  \
+    atomic_llong ticket = 0;                                                             \
+    if (tiles == NULL) {                                                                 \
+        scan_serial_##SUFFIX(in, out, n, 0, exclusive);                                  \
+        return;                                                                          \
+    }                                                                                    \
+                                                                                         \
+    _Pragma("omp parallel")                                                              \
+    {                                                                                    \
+        long long tile;                                                                  \
+        /* Tickets, not loop indices: a tile only ever waits on tiles that */           \
+        /* were claimed before it, so the look-back always makes progress */            \
+        while ((tile = atomic_fetch_add(&ticket, 1)) < num_tiles) {                     \
+            long long begin = tile * SCAN_TILE;                                          \
+            long long count = n - begin < SCAN_TILE ? n - begin : SCAN_TILE;             \
+            scan_tile_##SUFFIX##_t *self = &tiles[tile];                                 \
+                                                                                         \
+            T total = 0;                                                                 \
+            _Pragma("omp simd reduction(+:total)")                                       \
+            for (long long i = 0; i < count; i++) total += in[begin + i];                \
+                                                                                         \
+            T carry = 0;                                                                 \
+            if (tile == 0) {                                                             \
+                self->prefix = total;                                                    \
+                atomic_store_explicit(&self->status, SCAN_PREFIX, memory_order_release); \
+            } else {                                                                     \
+                self->aggregate = total;                                                 \
+                atomic_store_explicit(&self->status, SCAN_AGGREGATE,                     \
+                                      memory_order_release);                             \
+                for (long long p = tile - 1; p >= 0; p--) {                              \
+                    int status;                                                          \
+                    while ((status = atomic_load_explicit(&tiles[p].status,              \
+                                         memory_order_acquire)) == SCAN_EMPTY) {         \
+                        sched_yield(); /* predecessor may be preempted */                \
+                    }                                                                    \
+                    if (status == SCAN_PREFIX) {                                         \
+                        carry += tiles[p].prefix;                                        \
+                        break;                                                           \
+                    }                                                                    \
+                    carry += tiles[p].aggregate;                                         \
+                }                                                                        \
+                self->prefix = carry + total;                                            \
+                atomic_store_explicit(&self->status, SCAN_PREFIX, memory_order_release); \
+            }                                                                            \
+            scan_serial_##SUFFIX(in + begin, out + begin, count, carry, exclusive);      \
+        }                                                                                \
+    }                                                                                    \
+    free(tiles);                                                                         \
+}
+
+DEFINE_SCAN(f64, double)
+DEFINE_SCAN(i64, int64_t)
+
+#endif // SCAN_H